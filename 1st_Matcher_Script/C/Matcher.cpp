@@ -1,42 +1,29 @@
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <map>
-#include <filesystem>
-#include <thread>
-#include <mutex>
-#include <algorithm>
-#include <cmath>
-#include <future>
-#include <regex>
-#include <unordered_map> // Added for faster lookup
-#include <xlnt/xlnt.hpp> // Add this include for xlnt
-
-#define THREAD_NUM 8
+#include "MatcherEngine.hpp"
+#include <csignal>
 
 #ifdef _WIN32
 #include <windows.h>
 #include <commdlg.h>
 #include <shlobj.h>
 #include <commctrl.h>
+#include <deque>
 #endif
 
-// CSV/Excel-like data structure
-using Row = std::vector<std::string>;
-using DataFrame = std::vector<Row>;
-
-// Column definitions
-const std::vector<std::string> daily_cols = {
-    "AP", "AQ", "AR", "AS", "AT", "AU", "AV", "AW", "AX", "AY", "AZ", 
-    "BA", "BB", "BC", "BD", "BE", "BF", "BG", "BH", "BI", "BJ", "BK"
-};
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
 
-const std::vector<std::string> degree_cols = {
-    "AQ", "AS", "AU", "AW", "AY", "BA", "BC", "BE", "BG", "BI", "BK"
-};
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
+#ifdef _WIN32
 // Global variables for GUI
 HWND hMainWindow;
 HWND hDailyEntry;
@@ -44,355 +31,34 @@ HWND hHistEntry;
 HWND hProcessButton;
 HWND hStatusText;
 HWND hProgressBar;
+HWND hMatchesText;
 
 // Forward declaration for DataProcessor
 class DataProcessor;
 
 // Window procedure
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+#endif
 
-class CSVReader {
-public:
-    static DataFrame readCSV(const std::string& filename) {
-        if (endsWith(filename, ".csv")) {
-            return readCSVFile(filename);
-        } else if (endsWith(filename, ".xlsx")) {
-            return readXLSXFile(filename);
-        } else {
-            throw std::runtime_error("Unsupported file type: " + filename);
-        }
-    }
-    
-    static void writeCSV(const DataFrame& data, const std::string& filename) {
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            throw std::runtime_error("Cannot create file: " + filename);
-        }
-        
-        for (const auto& row : data) {
-            for (size_t i = 0; i < row.size(); ++i) {
-                if (i > 0) file << ",";
-                file << "\"" << row[i] << "\"";
-            }
-            file << "\n";
-        }
-    }
+DataProcessor* g_processor = nullptr;
 
-private:
-    static bool endsWith(const std::string& str, const std::string& suffix) {
-        return str.size() >= suffix.size() &&
-               str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
-    }
-
-    static DataFrame readCSVFile(const std::string& filename) {
-        DataFrame data;
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            throw std::runtime_error("Cannot open file: " + filename);
-        }
-        
-        std::string line;
-        while (std::getline(file, line)) {
-            Row row;
-            std::stringstream ss(line);
-            std::string cell;
-            
-            while (std::getline(ss, cell, ',')) {
-                // Remove quotes and trim whitespace
-                cell.erase(std::remove(cell.begin(), cell.end(), '"'), cell.end());
-                cell.erase(0, cell.find_first_not_of(" \t"));
-                cell.erase(cell.find_last_not_of(" \t") + 1);
-                row.push_back(cell);
-            }
-            if (!row.empty()) {
-                data.push_back(row);
-            }
-        }
-        return data;
-    }
+#ifdef _WIN32
+#define ID_PROGRESS_TIMER 2001
+#define WM_APP_PROCESS_DONE (WM_APP + 1)
+#define WM_APP_MATCHES (WM_APP + 2)
 
-    static DataFrame readXLSXFile(const std::string& filename) {
-        DataFrame data;
-        xlnt::workbook wb;
-        wb.load(filename);
-        auto ws = wb.active_sheet();
-        for (auto row : ws.rows(false)) {
-            Row row_data;
-            for (auto cell : row) {
-                row_data.push_back(cell.to_string());
-            }
-            data.push_back(row_data);
-        }
-        return data;
-    }
+// Handed from the processing thread to the UI thread with PostMessage
+struct ProcessOutcome {
+    std::vector<DataProcessor::RunResult> results;
+    std::string error;
 };
 
-class DataProcessor {
-private:
-    std::mutex matches_mutex;
-    
-public:
-    struct RowData {
-        std::string player;
-        std::map<std::string, std::string> data;
-        std::string total;
-        std::string winPercent;
-    };
-    
-    RowData parseRowToDict(const Row& row) {
-        RowData data;
-        if (row.empty()) return data;
-        
-        data.player = row[0];
-        
-        // Parse pairs of key-value starting from index 1
-        for (size_t i = 1; i < row.size() - 2; i += 2) {
-            if (i + 1 < row.size()) {
-                data.data[row[i]] = row[i + 1];
-            }
-        }
-        
-        if (row.size() >= 2) {
-            data.total = row[row.size() - 2];
-            data.winPercent = row[row.size() - 1];
-        }
-        
-        return data;
-    }
-    
-    bool degreeMatch(const std::string& daily_val, const std::string& hist_range) {
-        try {
-            std::regex range_regex(R"((\d+)-(\d+))");
-            std::smatch matches;
-            
-            if (std::regex_match(hist_range, matches, range_regex)) {
-                int low = std::stoi(matches[1]);
-                int high = std::stoi(matches[2]);
-                int daily_int = std::stoi(daily_val);
-                return daily_int >= low && daily_int <= high;
-            }
-            return false;
-        } catch (...) {
-            return false;
-        }
-    }
-    
-    std::vector<Row> processChunk(const std::vector<std::pair<size_t, const Row*>>& chunk,
-                                  const DataFrame& daily_df,
-                                  const DataFrame& raw_daily_df) {
-        std::vector<Row> matches;
-        
-        int match_count = 0; // Counter for matches in this chunk
-        for (const auto& [idx, row] : chunk) {
-            try {
-                // Update status text
-                if (idx % 10000 == 0) {
-                    std::string status_msg = "Processing row " + std::to_string(idx) + "...";
-                    SetWindowTextA(hStatusText, status_msg.c_str());
-                }
-                
-                RowData hist_row = parseRowToDict(*row);
-                
-                for (size_t i = 0; i < daily_df.size(); ++i) {
-                    const Row& daily_row = daily_df[i];
-                    if (daily_row[0] != hist_row.player) continue;
-                    bool is_match = true;
-                    
-                    // Check each column for matching
-                    for (const auto& [col, hist_val] : hist_row.data) {
-                        if (col == "WinPercent" || col == "Total") continue;
-                        
-                        // Find column index in daily data
-                        auto col_it = std::find(daily_cols.begin(), daily_cols.end(), col);
-                        if (col_it == daily_cols.end()) continue;
-                        
-                        size_t col_idx = std::distance(daily_cols.begin(), col_it) + 1; // +1 for Player column
-                        if (col_idx >= daily_row.size()) continue;
-                        
-                        std::string daily_val = daily_row[col_idx];
-                        
-                        if (daily_val.empty() || hist_val.empty()) continue;
-                        
-                        // Check if this is a degree column
-                        bool is_degree_col = std::find(degree_cols.begin(), degree_cols.end(), col) != degree_cols.end();
-                        
-                        if (is_degree_col) {
-                            if (!degreeMatch(daily_val, hist_val)) {
-                                is_match = false;
-                                break;
-                            }
-                        } else {
-                            if (daily_val != hist_val) {
-                                is_match = false;
-                                break;
-                            }
-                        }
-                    }
-                    
-                    if (is_match) {
-                        match_count++;
-                        if (match_count % 100 == 0) {
-                            std::string match_msg = "***** Found matching result for row " + std::to_string(idx) + " (" + std::to_string(match_count) + " matches) *****";
-                            SetWindowTextA(hStatusText, match_msg.c_str());
-                        }
-                        Row matched_row = raw_daily_df[i];
-                        matched_row.insert(matched_row.end(), row->begin(), row->end());
-                        matches.push_back(matched_row);
-                    }
-                }
-            } catch (const std::exception& e) {
-                std::string error_msg = "Error occurred in loop: " + std::string(e.what());
-                SetWindowTextA(hStatusText, error_msg.c_str());
-                continue;
-            }
-        }
-        
-        return matches;
-    }
-    
-    DataFrame filterDailyData(const DataFrame& raw_daily_df) {
-        DataFrame filtered_data;
-        
-        for (const Row& row : raw_daily_df) {
-            Row filtered_row;
-            
-            // Extract column 0 (Player)
-            if (!row.empty()) {
-                filtered_row.push_back(row[0]);
-            }
-            
-            // Extract columns 41-62 (indices 41-62)
-            for (int i = 41; i <= 62 && i < static_cast<int>(row.size()); ++i) {
-                filtered_row.push_back(row[i]);
-            }
-            
-            if (!filtered_row.empty()) {
-                filtered_data.push_back(filtered_row);
-            }
-        }
-        
-        return filtered_data;
-    }
-    
-    void processFiles(const std::string& daily_file, const std::string& historical_folder) {
-        try {
-            SetWindowTextA(hStatusText, "Starting processing...");
-            EnableWindow(hProcessButton, FALSE);
-            
-            // Check if files exist
-            if (!std::filesystem::exists(daily_file) || !std::filesystem::exists(historical_folder)) {
-                MessageBoxA(hMainWindow, "One or both files not found.", "Error", MB_OK | MB_ICONERROR);
-                EnableWindow(hProcessButton, TRUE);
-                return;
-            }
-            
-            // Read daily file (now supports .csv and .xlsx)
-            SetWindowTextA(hStatusText, "Reading daily file...");
-            DataFrame raw_daily_df = CSVReader::readCSV(daily_file);
-            DataFrame daily_df = filterDailyData(raw_daily_df);
-            
-            std::vector<Row> all_matches;
-            
-            // Count total files for progress
-            int total_files = 0;
-            for (const auto& entry : std::filesystem::directory_iterator(historical_folder)) {
-                if (entry.is_regular_file()) {
-                    std::string ext = entry.path().extension().string();
-                    if (ext == ".csv" || ext == ".xlsx") {
-                        total_files++;
-                    }
-                }
-            }
-            
-            SendMessage(hProgressBar, PBM_SETRANGE, 0, MAKELPARAM(0, total_files));
-            SendMessage(hProgressBar, PBM_SETPOS, 0, 0);
-            
-            int processed_files = 0;
-            
-            // Process each file in historical folder
-            for (const auto& entry : std::filesystem::directory_iterator(historical_folder)) {
-                if (entry.is_regular_file()) {
-                    std::string file_path = entry.path().string();
-                    std::string file_name = entry.path().filename().string();
-                    
-                    // Skip non-CSV/XLSX files
-                    std::string ext = entry.path().extension().string();
-                    if (ext != ".csv" && ext != ".xlsx") {
-                        continue;
-                    }
-                    
-                    std::string status_msg = "Processing file: " + file_name;
-                    SetWindowTextA(hStatusText, status_msg.c_str());
-                    
-                    DataFrame raw_hist_df = CSVReader::readCSV(file_path);
-                    
-                    // Create chunks for parallel processing
-                    std::vector<std::pair<size_t, const Row*>> all_rows;
-                    for (size_t i = 0; i < raw_hist_df.size(); ++i) {
-                        all_rows.emplace_back(i, &raw_hist_df[i]);
-                    }
-                    
-                    size_t num_threads = std::min<size_t>(THREAD_NUM, all_rows.size());
-                    size_t chunk_size = std::ceil(static_cast<double>(all_rows.size()) / num_threads);
-                    std::vector<std::future<std::vector<Row>>> futures;
-                    
-                    // Process chunks in parallel
-                    for (size_t i = 0; i < all_rows.size(); i += chunk_size) {
-                        size_t end = std::min(i + chunk_size, all_rows.size());
-                        std::vector<std::pair<size_t, const Row*>> chunk(all_rows.begin() + i, all_rows.begin() + end);
-                        
-                        futures.push_back(std::async(std::launch::async, [this, chunk, &daily_df, &raw_daily_df]() {
-                            return processChunk(chunk, daily_df, raw_daily_df);
-                        }));
-                    }
-                    
-                    // Collect results
-                    for (auto& future : futures) {
-                        auto chunk_matches = future.get();
-                        all_matches.insert(all_matches.end(), chunk_matches.begin(), chunk_matches.end());
-                    }
-                    
-                    processed_files++;
-                    SendMessage(hProgressBar, PBM_SETPOS, processed_files, 0);
-                    
-                    std::string success_msg = "--------------- " + file_name + " Processed successfully ---------------";
-                    SetWindowTextA(hStatusText, success_msg.c_str());
-                }
-            }
-            
-            // Save results
-            if (!all_matches.empty()) {
-                SetWindowTextA(hStatusText, "Saving matches...");
-                // Remove empty rows
-                all_matches.erase(
-                    std::remove_if(all_matches.begin(), all_matches.end(),
-                        [](const Row& row) { return row.empty(); }),
-                    all_matches.end()
-                );
-                
-                std::string output_path = daily_file.substr(0, daily_file.find_last_of('.')) + "_Matches.csv";
-                CSVReader::writeCSV(all_matches, output_path);
-                
-                std::string success_msg = "Processing finished. Results saved to: " + output_path;
-                SetWindowTextA(hStatusText, success_msg.c_str());
-                MessageBoxA(hMainWindow, success_msg.c_str(), "Success", MB_OK | MB_ICONINFORMATION);
-            } else {
-                SetWindowTextA(hStatusText, "NO Matches found...");
-                MessageBoxA(hMainWindow, "NO Matches found...", "No Results", MB_OK | MB_ICONWARNING);
-            }
-            
-        } catch (const std::exception& e) {
-            std::string error_msg = "Error occurred: " + std::string(e.what());
-            SetWindowTextA(hStatusText, error_msg.c_str());
-            MessageBoxA(hMainWindow, error_msg.c_str(), "Error", MB_OK | MB_ICONERROR);
-        }
-        
-        EnableWindow(hProcessButton, TRUE);
-        SendMessage(hProgressBar, PBM_SETPOS, 0, 0);
-    }
-};
+bool g_processing = false;
+std::thread g_worker;     // The processing thread; joined before the next run and on close
 
-DataProcessor* g_processor = nullptr;
+// Newest matched rows of the current run, shown as files finish
+const size_t shown_match_rows = 500;
+std::deque<std::string> g_shown_matches;
 
 // File dialog functions
 std::string openFileDialog() {
@@ -449,6 +115,12 @@ void OnBrowseHist() {
 }
 
 void OnProcess() {
+    if (g_processing) {
+        g_processor->getCancelToken().cancel();
+        SetWindowTextA(hStatusText, "Cancelling...");
+        return;
+    }
+    
     char daily_path[260];
     char hist_path[260];
     
@@ -460,10 +132,94 @@ void OnProcess() {
         return;
     }
     
-    // Start processing in a separate thread
-    std::thread([daily_path, hist_path]() {
-        g_processor->processFiles(daily_path, hist_path);
-    }).detach();
+    if (g_worker.joinable()) g_worker.join();   // Done: it posted its outcome
+    g_processing = true;
+    g_processor->getCancelToken().reset();
+    SetWindowTextA(hProcessButton, "Cancel");
+    SetWindowTextA(hStatusText, "Starting processing...");
+    g_shown_matches.clear();
+    SetWindowTextA(hMatchesText, "");
+    SetTimer(hMainWindow, ID_PROGRESS_TIMER, 250, NULL);
+    
+    // Start processing in a separate thread. It never talks to the window
+    // directly; the timer samples its counters, and each file's matched rows
+    // and finally the result are posted back.
+    std::string daily(daily_path);
+    std::string hist(hist_path);
+    g_worker = std::thread([daily, hist]() {
+        ProcessOutcome* outcome = new ProcessOutcome();
+        try {
+            DataProcessor::RunOptions options;
+            options.on_matches = [](const std::string&, const std::string& rows) {
+                std::string* posted = new std::string(rows);
+                if (!PostMessage(hMainWindow, WM_APP_MATCHES, 0, reinterpret_cast<LPARAM>(posted))) delete posted;
+            };
+            // A folder in the daily entry runs every daily file in it as one batch.
+            outcome->results = g_processor->processBatch({daily}, hist, options);
+        } catch (const std::exception& e) {
+            outcome->error = e.what();
+        }
+        if (!PostMessage(hMainWindow, WM_APP_PROCESS_DONE, 0, reinterpret_cast<LPARAM>(outcome))) delete outcome;
+    });
+}
+
+void OnProgressTimer() {
+    const EngineProgress& progress = g_processor->getProgress();
+    SetWindowTextA(hStatusText, formatProgress(progress).c_str());
+    SendMessage(hProgressBar, PBM_SETRANGE32, 0, static_cast<LPARAM>(progress.files_total.load()));
+    SendMessage(hProgressBar, PBM_SETPOS, static_cast<WPARAM>(progress.files_done.load()), 0);
+}
+
+// Shows the rows of a file as soon as it is matched, long before the output
+// is published; only the newest shown_match_rows are kept
+void OnMatches(std::string* rows) {
+    std::istringstream lines(*rows);
+    delete rows;
+    for (std::string line; std::getline(lines, line);) {
+        g_shown_matches.push_back(std::move(line));
+        if (g_shown_matches.size() > shown_match_rows) g_shown_matches.pop_front();
+    }
+    std::string text;
+    for (const std::string& line : g_shown_matches) text += line + "\r\n";
+    SetWindowTextA(hMatchesText, text.c_str());
+    SendMessage(hMatchesText, EM_SETSEL, static_cast<WPARAM>(text.size()), static_cast<LPARAM>(text.size()));
+    SendMessage(hMatchesText, EM_SCROLLCARET, 0, 0);
+}
+
+void OnProcessDone(ProcessOutcome* outcome) {
+    KillTimer(hMainWindow, ID_PROGRESS_TIMER);
+    g_processing = false;
+    SetWindowTextA(hProcessButton, "Process");
+    
+    if (!outcome->error.empty()) {
+        std::string error_msg = "Error occurred: " + outcome->error;
+        SetWindowTextA(hStatusText, error_msg.c_str());
+        MessageBoxA(hMainWindow, error_msg.c_str(), "Error", MB_OK | MB_ICONERROR);
+    } else if (outcome->results.empty()) {
+        SetWindowTextA(hStatusText, "NO daily files found...");
+        MessageBoxA(hMainWindow, "NO daily files found...", "No Results", MB_OK | MB_ICONWARNING);
+    } else if (outcome->results.front().cancelled) {
+        SetWindowTextA(hStatusText, "Processing cancelled.");
+    } else if (outcome->results.size() > 1) {
+        size_t with_matches = 0;
+        for (const auto& result : outcome->results) {
+            if (!result.output_path.empty()) with_matches++;
+        }
+        std::string success_msg = "Processing finished. " + std::to_string(with_matches) + " of " +
+                                  std::to_string(outcome->results.size()) + " daily files had matches.";
+        SetWindowTextA(hStatusText, success_msg.c_str());
+        MessageBoxA(hMainWindow, success_msg.c_str(), "Success", MB_OK | MB_ICONINFORMATION);
+    } else if (!outcome->results.front().output_path.empty()) {
+        std::string success_msg = "Processing finished. Results saved to: " + outcome->results.front().output_path;
+        SetWindowTextA(hStatusText, success_msg.c_str());
+        MessageBoxA(hMainWindow, success_msg.c_str(), "Success", MB_OK | MB_ICONINFORMATION);
+    } else {
+        SetWindowTextA(hStatusText, "NO Matches found...");
+        MessageBoxA(hMainWindow, "NO Matches found...", "No Results", MB_OK | MB_ICONWARNING);
+    }
+    
+    SendMessage(hProgressBar, PBM_SETPOS, 0, 0);
+    delete outcome;
 }
 
 // Window procedure
@@ -477,7 +233,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             int height = HIWORD(lParam);
             
             // Resize controls based on window size
-            if (hDailyEntry && hHistEntry && hProcessButton && hStatusText && hProgressBar) {
+            if (hDailyEntry && hHistEntry && hProcessButton && hStatusText && hProgressBar && hMatchesText) {
                 // Calculate new positions and sizes
                 int labelWidth = 162; // 90% of original 180px
                 int entryWidth = width - labelWidth - 100; // Leave space for browse button
@@ -497,6 +253,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 // Resize status text and progress bar
                 SetWindowPos(hStatusText, NULL, 10, 140, width - 20, 30, SWP_NOZORDER);
                 SetWindowPos(hProgressBar, NULL, 10, 180, width - 20, 20, SWP_NOZORDER);
+                SetWindowPos(hMatchesText, NULL, 10, 210, width - 20, std::max(height - 220, 40), SWP_NOZORDER);
             }
             return 0;
         }
@@ -515,7 +272,36 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             }
             return 0;
             
+        case WM_TIMER:
+            if (wParam == ID_PROGRESS_TIMER) {
+                OnProgressTimer();
+            }
+            return 0;
+            
+        case WM_APP_PROCESS_DONE:
+            OnProcessDone(reinterpret_cast<ProcessOutcome*>(lParam));
+            return 0;
+            
+        case WM_APP_MATCHES:
+            OnMatches(reinterpret_cast<std::string*>(lParam));
+            return 0;
+            
         case WM_DESTROY:
+            // The processing thread uses g_processor, so a run is cancelled
+            // and waited for before the message loop ends. Its rows and
+            // outcome are posted to this window and would otherwise leak.
+            KillTimer(hwnd, ID_PROGRESS_TIMER);
+            if (g_worker.joinable()) {
+                g_processor->getCancelToken().cancel();
+                g_worker.join();
+                MSG done;
+                while (PeekMessage(&done, hwnd, WM_APP_PROCESS_DONE, WM_APP_PROCESS_DONE, PM_REMOVE)) {
+                    delete reinterpret_cast<ProcessOutcome*>(done.lParam);
+                }
+                while (PeekMessage(&done, hwnd, WM_APP_MATCHES, WM_APP_MATCHES, PM_REMOVE)) {
+                    delete reinterpret_cast<std::string*>(done.lParam);
+                }
+            }
             PostQuitMessage(0);
             return 0;
     }
@@ -594,6 +380,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     hProgressBar = CreateWindow(PROGRESS_CLASS, NULL, WS_VISIBLE | WS_CHILD,
         10, 170, 870, 20, hMainWindow, NULL, hInstance, NULL);
     
+    // Matched rows, streamed while processing
+    hMatchesText = CreateWindow("EDIT", "", WS_VISIBLE | WS_CHILD | WS_BORDER | WS_VSCROLL | WS_HSCROLL |
+        ES_MULTILINE | ES_READONLY | ES_AUTOVSCROLL | ES_AUTOHSCROLL,
+        10, 210, 870, 140, hMainWindow, NULL, hInstance, NULL);
+    SendMessage(hMatchesText, EM_SETLIMITTEXT, 0, 0);
+    
     // Initialize processor
     g_processor = new DataProcessor();
     
@@ -613,4 +405,920 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     CoUninitialize();
     
     return 0;
-}
\ No newline at end of file
+}
+#else
+// Command line front-end for non-Windows builds
+CancellationToken g_interrupt;
+
+void onInterrupt(int) {
+    g_interrupt.cancel();
+    if (g_processor) g_processor->getCancelToken().cancel();
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point started) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+// Values of numeric options; text that is not entirely a non-negative number
+// is a usage error rather than an uncaught std::stod exception
+double numberOption(const std::string& flag, const std::string& text) {
+    size_t used = 0;
+    double value = -1;
+    try {
+        value = std::stod(text, &used);
+    } catch (const std::exception&) {
+    }
+    if (used != text.size() || !(value >= 0) || !std::isfinite(value)) {
+        throw std::runtime_error("Invalid value for " + flag + ": " + text);
+    }
+    return value;
+}
+
+uint64_t countOption(const std::string& flag, const std::string& text) {
+    size_t used = 0;
+    uint64_t value = 0;
+    try {
+        if (!text.empty() && text[0] != '-') value = std::stoull(text, &used);
+    } catch (const std::exception&) {
+    }
+    if (used == 0 || used != text.size()) throw std::runtime_error("Invalid value for " + flag + ": " + text);
+    return value;
+}
+
+// Set from --min-total, --min-win-percent and --max-rows-per-player, which
+// every command accepts anywhere on its command line
+PatternFilter g_pattern_filter;
+
+PatternFilter takeFilterOptions(std::vector<std::string>& args) {
+    PatternFilter filter;
+    std::vector<std::string> rest;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--min-total" && i + 1 < args.size()) {
+            filter.min_total = numberOption(args[i], args[i + 1]);
+            ++i;
+        } else if (args[i] == "--min-win-percent" && i + 1 < args.size()) {
+            filter.min_win_percent = numberOption(args[i], args[i + 1]);
+            ++i;
+        } else if (args[i] == "--max-rows-per-player" && i + 1 < args.size()) {
+            uint64_t rows = countOption(args[i], args[i + 1]);
+            if (rows > UINT32_MAX) throw std::runtime_error("Invalid value for " + args[i] + ": " + args[i + 1]);
+            filter.max_rows_per_player = static_cast<uint32_t>(rows);
+            ++i;
+        } else {
+            rest.push_back(args[i]);
+        }
+    }
+    args = std::move(rest);
+    return filter;
+}
+
+// The same flags, for worker processes
+std::vector<std::string> filterArguments(const PatternFilter& filter) {
+    std::vector<std::string> arguments;
+    auto exact = [](double value) {
+        std::ostringstream text;
+        text.precision(17);
+        text << value;
+        return text.str();
+    };
+    if (filter.min_total > 0) arguments.insert(arguments.end(), {"--min-total", exact(filter.min_total)});
+    if (filter.min_win_percent > 0) arguments.insert(arguments.end(), {"--min-win-percent", exact(filter.min_win_percent)});
+    if (filter.max_rows_per_player > 0) {
+        arguments.insert(arguments.end(), {"--max-rows-per-player", std::to_string(filter.max_rows_per_player)});
+    }
+    return arguments;
+}
+
+// Matches one daily file against the resident corpus and writes <name>_Matches.csv next to it
+void matchDroppedFile(ResidentCorpus& corpus, ResidentCorpus::Session& session, const std::string& daily_file) {
+    auto started = std::chrono::steady_clock::now();
+    DailySlate slate = corpus.compileSlate(daily_file, CSVReader::readCSV(daily_file));
+    double read_ms = millisecondsSince(started);
+    
+    size_t match_count = 0;
+    std::string output = corpus.matchSlate(slate, match_count, &session);
+    double match_ms = millisecondsSince(started) - read_ms;
+    
+    std::string name = std::filesystem::path(daily_file).filename().string();
+    if (match_count == 0) {
+        std::cout << name << ": NO Matches found..." << std::endl;
+        return;
+    }
+    writeFileAtomically(DataProcessor::outputPathFor(daily_file), output);
+    double write_ms = millisecondsSince(started) - read_ms - match_ms;
+    std::cout << name << ": " << match_count << " matches (read " << read_ms << " ms, match " << match_ms
+              << " ms, write " << write_ms << " ms)" << std::endl;
+}
+
+std::unique_ptr<ResidentCorpus> loadResidentCorpus(const std::string& historical_folder) {
+    auto started = std::chrono::steady_clock::now();
+    auto corpus = std::make_unique<ResidentCorpus>(historical_folder, g_pattern_filter);
+    corpus->load();
+    std::cerr << "Corpus loaded: " << corpus->fileCount() << " files, " << corpus->patternCount()
+              << " patterns in " << millisecondsSince(started) << " ms" << std::endl;
+    return corpus;
+}
+
+// Line-oriented reads and writes over a connected stream socket
+class SocketConnection {
+public:
+    explicit SocketConnection(int socket_fd) : fd(socket_fd) {}
+    ~SocketConnection() { close(fd); }
+    SocketConnection(const SocketConnection&) = delete;
+    SocketConnection& operator=(const SocketConnection&) = delete;
+    
+    // Returns false on end of stream, on error, or once stop is cancelled
+    bool readLine(std::string& line, const CancellationToken& stop) {
+        for (;;) {
+            size_t newline = buffer.find('\n');
+            if (newline != std::string::npos) {
+                line.assign(buffer, 0, newline);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                buffer.erase(0, newline + 1);
+                return true;
+            }
+            pollfd pfd = {fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, 250);
+            if (stop.isCancelled()) return false;
+            if (ready <= 0) continue;
+            char chunk[64 * 1024];
+            ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) return false;
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+    }
+    
+    bool writeAll(const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = send(fd, data.data() + sent, data.size() - sent, 0);
+            if (written <= 0) return false;
+            sent += static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+private:
+    int fd;
+    std::string buffer;
+};
+
+struct ServiceStats {
+    PaddedCounter clients;
+    PaddedCounter requests;
+    PaddedCounter matches;
+    LatencyHistogram latency_us;
+    
+    std::string format() const {
+        std::string text;
+        text += "clients " + std::to_string(clients.load()) + "\n";
+        text += "requests " + std::to_string(requests.load()) + "\n";
+        text += "matches " + std::to_string(matches.load()) + "\n";
+        text += "latency_us_mean " + std::to_string(static_cast<uint64_t>(latency_us.mean())) + "\n";
+        text += "latency_us_p50 " + std::to_string(latency_us.percentile(50)) + "\n";
+        text += "latency_us_p90 " + std::to_string(latency_us.percentile(90)) + "\n";
+        text += "latency_us_p99 " + std::to_string(latency_us.percentile(99)) + "\n";
+        text += "latency_us_max " + std::to_string(latency_us.max()) + "\n";
+        return text;
+    }
+};
+
+// Serves one client connection. Requests and responses are lines:
+//   MATCH <n>  followed by n raw daily rows  ->  OK <count>  and count match rows
+//   STATS                                    ->  OK <k>      and k "name value" lines
+//   QUIT
+// Anything malformed gets "ERR <reason>".
+void serveClient(int client_fd, ResidentCorpus& corpus, ServiceStats& stats) {
+    SocketConnection connection(client_fd);
+    ResidentCorpus::Session session;    // This client's slates re-evaluate incrementally
+    stats.clients.add(1);
+    std::string line;
+    while (connection.readLine(line, g_interrupt)) {
+        auto started = std::chrono::steady_clock::now();
+        std::string response;
+        if (line.rfind("MATCH ", 0) == 0) {
+            size_t row_count = 0;
+            try {
+                row_count = std::stoul(line.substr(6));
+            } catch (...) {
+                connection.writeAll("ERR bad row count\n");
+                continue;
+            }
+            DataFrame rows;
+            for (size_t i = 0; i < row_count; ++i) {
+                if (!connection.readLine(line, g_interrupt)) return;
+                rows.push_back(CSVReader::parseCSVLine(line));
+            }
+            size_t match_count = 0;
+            std::string body = corpus.matchSlate(corpus.compileSlate("<socket>", rows), match_count, &session);
+            response = "OK " + std::to_string(match_count) + "\n" + body;
+            if (!connection.writeAll(response)) return;
+            stats.requests.add(1);
+            stats.matches.add(match_count);
+            stats.latency_us.record(static_cast<uint64_t>(millisecondsSince(started) * 1000.0));
+            continue;
+        }
+        if (line == "STATS") {
+            std::string text = stats.format();
+            text += "patterns_rechecked " + std::to_string(corpus.patternsRechecked()) + "\n";
+            text += "patterns_reused " + std::to_string(corpus.patternsReused()) + "\n";
+            response = "OK " + std::to_string(std::count(text.begin(), text.end(), '\n')) + "\n" + text;
+        } else if (line == "QUIT") {
+            return;
+        } else {
+            response = "ERR unknown command\n";
+        }
+        if (!connection.writeAll(response)) return;
+    }
+}
+
+sockaddr_un socketAddress(const std::string& socket_path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + socket_path);
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+// Serves matches from the resident corpus over a Unix domain socket
+int runServe(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "Usage: serve <historical_folder> <socket_path>" << std::endl;
+        return 1;
+    }
+    std::unique_ptr<ResidentCorpus> corpus = loadResidentCorpus(args[0]);
+    const std::string& socket_path = args[1];
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error("Cannot create socket");
+    }
+    sockaddr_un address = socketAddress(socket_path);
+    unlink(socket_path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 64) < 0) {
+        close(listener);
+        throw std::runtime_error("Cannot listen on " + socket_path);
+    }
+    std::cerr << "Serving on " << socket_path << " (Ctrl+C to stop)" << std::endl;
+    
+    // One thread per connection: a connected client, even an idle one, never
+    // keeps the next from being served. Finished threads are reaped as new
+    // clients arrive; the rest end with their connections on Ctrl+C. Beyond
+    // max_clients connections at once, a new one is refused with "ERR busy".
+    const size_t max_clients = 64;
+    ServiceStats stats;
+    struct ClientThread {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+    std::vector<ClientThread> clients;
+    while (!g_interrupt.isCancelled()) {
+        pollfd pfd = {listener, POLLIN, 0};
+        if (poll(&pfd, 1, 250) <= 0) continue;
+        int client_fd = accept(listener, nullptr, nullptr);
+        if (client_fd < 0) continue;
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (!it->finished->load()) {
+                ++it;
+                continue;
+            }
+            it->thread.join();
+            it = clients.erase(it);
+        }
+        if (clients.size() >= max_clients) {
+            SocketConnection(client_fd).writeAll("ERR busy\n");
+            continue;
+        }
+        auto finished = std::make_shared<std::atomic<bool>>(false);
+        ResidentCorpus* shared_corpus = corpus.get();
+        clients.push_back({std::thread([client_fd, shared_corpus, &stats, finished]() {
+            try {
+                serveClient(client_fd, *shared_corpus, stats);
+            } catch (const std::exception& e) {
+                std::cerr << "Error occurred: " << e.what() << std::endl;
+            }
+            finished->store(true);
+        }), finished});
+    }
+    for (ClientThread& client : clients) client.thread.join();
+    close(listener);
+    unlink(socket_path.c_str());
+    std::cerr << stats.format();
+    return 0;
+}
+
+// Test client: sends a daily file (or STATS) to a running service
+int runClient(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "Usage: client <socket_path> <daily_file | --stats>" << std::endl;
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = socketAddress(args[0]);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("Cannot connect to " + args[0]);
+    }
+    SocketConnection connection(fd);
+    
+    auto started = std::chrono::steady_clock::now();
+    std::string request;
+    if (args[1] == "--stats") {
+        request = "STATS\n";
+    } else {
+        DataFrame rows = CSVReader::readCSV(args[1]);
+        request = "MATCH " + std::to_string(rows.size()) + "\n";
+        for (const Row& row : rows) {
+            for (size_t i = 0; i < row.size(); ++i) {
+                if (i > 0) request += ',';
+                request += row[i];
+            }
+            request += '\n';
+        }
+    }
+    std::string line;
+    if (!connection.writeAll(request) || !connection.readLine(line, g_interrupt)) {
+        throw std::runtime_error("Connection closed by service");
+    }
+    if (line.rfind("OK ", 0) != 0) {
+        std::cerr << line << std::endl;
+        return 1;
+    }
+    size_t line_count = std::stoul(line.substr(3));
+    for (size_t i = 0; i < line_count && connection.readLine(line, g_interrupt); ++i) {
+        std::cout << line << "\n";
+    }
+    connection.writeAll("QUIT\n");
+    std::cerr << line_count << " lines in " << millisecondsSince(started) << " ms" << std::endl;
+    return 0;
+}
+
+// Shard worker: matches the listed historical files ("<index>\t<path>" lines)
+// one at a time and streams "<index>\t<match row>" lines to stdout
+int runWorker(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "Usage: worker <daily_file> <file_list>" << std::endl;
+        return 1;
+    }
+    DataProcessor engine;
+    engine.setPatternFilter(g_pattern_filter);
+    std::vector<DailySlate> slates;
+    slates.push_back(engine.compileDailySlate(args[0], CSVReader::readCSV(args[0])));
+    engine.getSelectivity().observe(slates[0]);
+    ZoneProbe probe = engine.buildZoneProbe(slates);
+    
+    std::ifstream list(args[1]);
+    if (!list.is_open()) {
+        throw std::runtime_error("Cannot open file: " + args[1]);
+    }
+    std::string line;
+    std::string buffer;
+    while (std::getline(list, line) && !g_interrupt.isCancelled()) {
+        size_t tab = line.find('\t');
+        std::string index = line.substr(0, tab);
+        CompiledFile file = engine.compileFile(line.substr(tab + 1));
+        uint64_t blocks_skipped = 0;
+        std::vector<uint8_t> live_blocks = DataProcessor::liveBlocks(file, probe, blocks_skipped);
+        std::vector<std::vector<MatchRef>> matches = engine.matchFile(file, slates, &live_blocks);
+        buffer.clear();
+        for (const MatchRef& match : matches[0]) {
+            buffer += index;
+            buffer += '\t';
+            buffer += slates[0].rendered[match.daily];
+            buffer += ',';
+            buffer += file.rowText(file.patterns[match.pattern]);
+            buffer += '\n';
+        }
+        std::cout.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    std::cout.flush();
+    return g_interrupt.isCancelled() ? 130 : 0;
+}
+
+std::string g_executable;
+
+// Output side of a spawned shard worker, positioned on its next match line
+struct WorkerStream {
+    pid_t pid = -1;
+    FILE* output = nullptr;
+    char* line = nullptr;
+    size_t capacity = 0;
+    ssize_t length = 0;
+    long long file_index = -1;  // -1 once the stream is exhausted
+    
+    void advance() {
+        length = ::getline(&line, &capacity, output);
+        file_index = length > 0 ? std::atoll(line) : -1;
+    }
+    
+    std::string_view row() const {
+        const char* tab = static_cast<const char*>(std::memchr(line, '\t', length));
+        const char* begin = tab ? tab + 1 : line;
+        return std::string_view(begin, static_cast<size_t>(line + length - begin));
+    }
+};
+
+WorkerStream spawnWorker(const std::vector<std::string>& arguments) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("Cannot create pipe");
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    
+    std::vector<char*> argv;
+    for (const std::string& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+    
+    WorkerStream worker;
+    int error = posix_spawn(&worker.pid, g_executable.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (error != 0) {
+        close(fds[0]);
+        throw std::runtime_error("Cannot start worker process " + g_executable);
+    }
+    worker.output = fdopen(fds[0], "r");
+    return worker;
+}
+
+// Whatever way runShard exits, its workers are reaped (killed first unless
+// already done) and its work directory and unpublished output removed
+struct ShardCleanup {
+    std::vector<WorkerStream> workers;
+    std::filesystem::path work_dir;
+    std::string temporary_output;
+    
+    // True when every worker exited with status 0
+    bool reap(bool kill_first) {
+        bool succeeded = true;
+        for (WorkerStream& worker : workers) {
+            if (worker.pid <= 0) continue;
+            if (kill_first) kill(worker.pid, SIGTERM);
+            if (worker.output) fclose(worker.output);
+            free(worker.line);
+            worker.output = nullptr;
+            worker.line = nullptr;
+            int status = 0;
+            waitpid(worker.pid, &status, 0);
+            worker.pid = -1;
+            succeeded = succeeded && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        return succeeded;
+    }
+    
+    ~ShardCleanup() {
+        reap(true);
+        std::error_code ignored;
+        if (!work_dir.empty()) std::filesystem::remove_all(work_dir, ignored);
+        if (!temporary_output.empty()) std::filesystem::remove(temporary_output, ignored);
+    }
+};
+
+// Coordinator: partitions the historical folder across worker processes and
+// merges their streams into the same _Matches.csv a single process writes
+int runShard(const std::vector<std::string>& args) {
+    size_t worker_count = 4;
+    std::string strategy = "size";
+    std::vector<std::string> positional;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--workers" && i + 1 < args.size()) {
+            worker_count = countOption(args[i], args[i + 1]);
+            if (worker_count == 0) throw std::runtime_error("Invalid value for --workers: 0");
+            ++i;
+        } else if (args[i] == "--by" && i + 1 < args.size()) {
+            strategy = args[++i];
+        } else {
+            positional.push_back(args[i]);
+        }
+    }
+    if (positional.size() < 2 || (strategy != "size" && strategy != "player")) {
+        std::cerr << "Usage: shard [--workers N] [--by size|player] <daily_file> <historical_folder>" << std::endl;
+        return 1;
+    }
+    const std::string& daily_file = positional[0];
+    if (!std::filesystem::exists(daily_file) || !std::filesystem::exists(positional[1])) {
+        throw std::runtime_error("One or both files not found.");
+    }
+    std::vector<std::string> files = DataProcessor::listHistoricalFiles(positional[1]);
+    worker_count = std::max<size_t>(1, std::min(worker_count, files.size()));
+    
+    // By player: hash of the file name, so a player's file always lands on the
+    // same worker. By size: largest files first onto the least loaded worker.
+    std::vector<std::vector<size_t>> shards(worker_count);
+    std::vector<uint64_t> shard_bytes(worker_count, 0);
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < files.size(); ++i) order[i] = i;
+    std::vector<uint64_t> sizes(files.size());
+    for (size_t i = 0; i < files.size(); ++i) sizes[i] = std::filesystem::file_size(files[i]);
+    if (strategy == "size") {
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+    }
+    for (size_t i : order) {
+        size_t shard = strategy == "player"
+            ? std::hash<std::string>{}(std::filesystem::path(files[i]).filename().string()) % worker_count
+            : static_cast<size_t>(std::min_element(shard_bytes.begin(), shard_bytes.end()) - shard_bytes.begin());
+        shards[shard].push_back(i);
+        shard_bytes[shard] += sizes[i];
+    }
+    
+    std::string output_path = DataProcessor::outputPathFor(daily_file);
+    ShardCleanup cleanup;
+    std::vector<WorkerStream>& workers = cleanup.workers;
+    std::filesystem::path work_dir = std::filesystem::temp_directory_path() / ("matcher_shard_" + std::to_string(getpid()));
+    cleanup.work_dir = work_dir;
+    cleanup.temporary_output = output_path + ".tmp";
+    std::filesystem::create_directories(work_dir);
+    for (size_t w = 0; w < worker_count; ++w) {
+        std::sort(shards[w].begin(), shards[w].end());
+        std::string list_path = (work_dir / ("shard_" + std::to_string(w) + ".txt")).string();
+        std::ofstream list(list_path);
+        for (size_t i : shards[w]) list << i << '\t' << files[i] << '\n';
+        list.close();
+        std::cerr << "Worker " << w << ": " << shards[w].size() << " files, "
+                  << shard_bytes[w] / (1024 * 1024) << " MB" << std::endl;
+        std::vector<std::string> arguments = {g_executable, "worker", daily_file, list_path};
+        std::vector<std::string> filter_arguments = filterArguments(g_pattern_filter);
+        arguments.insert(arguments.end(), filter_arguments.begin(), filter_arguments.end());
+        workers.push_back(spawnWorker(arguments));
+    }
+    
+    // Each worker emits its files in ascending index order, so a k-way merge
+    // on the file index restores the single-process order
+    std::ofstream output;
+    size_t match_count = 0;
+    for (WorkerStream& worker : workers) worker.advance();
+    for (;;) {
+        WorkerStream* next = nullptr;
+        for (WorkerStream& worker : workers) {
+            if (worker.file_index >= 0 && (!next || worker.file_index < next->file_index)) next = &worker;
+        }
+        if (!next) break;
+        if (!output.is_open()) {
+            output.open(output_path + ".tmp");
+            if (!output.is_open()) {
+                throw std::runtime_error("Cannot create file: " + output_path);
+            }
+        }
+        long long current = next->file_index;
+        while (next->file_index == current) {
+            output << next->row();
+            match_count++;
+            next->advance();
+        }
+    }
+    
+    if (!cleanup.reap(false)) {
+        throw std::runtime_error("A worker process failed; no output written");
+    }
+    if (output.is_open()) {
+        output.close();
+        if (!output) {
+            throw std::runtime_error("Cannot write file: " + output_path);
+        }
+        std::filesystem::rename(output_path + ".tmp", output_path);
+    }
+    if (match_count == 0) {
+        std::cout << "NO Matches found..." << std::endl;
+    } else {
+        std::cout << "Processing finished. Results saved to: " << output_path << " (" << match_count << " matches)" << std::endl;
+    }
+    return 0;
+}
+
+// Keeps the corpus resident and matches every daily file dropped into a folder
+int runWatch(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "Usage: watch <historical_folder> <drop_folder>" << std::endl;
+        return 1;
+    }
+#ifdef __linux__
+    std::unique_ptr<ResidentCorpus> corpus = loadResidentCorpus(args[0]);
+    ResidentCorpus::Session session;
+    const std::string& drop_folder = args[1];
+    
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("inotify_init1 failed");
+    }
+    int drop_wd = inotify_add_watch(fd, drop_folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    int corpus_wd = inotify_add_watch(fd, corpus->getFolder().c_str(),
+                                      IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM);
+    if (drop_wd < 0 || corpus_wd < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot watch " + drop_folder + " or " + corpus->getFolder());
+    }
+    std::cerr << "Watching " << drop_folder << " for daily files (Ctrl+C to stop)" << std::endl;
+    
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while (!g_interrupt.isCancelled()) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 250) <= 0) continue;
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0) continue;
+            
+            std::filesystem::path path = std::filesystem::path(event->wd == corpus_wd ? corpus->getFolder() : drop_folder) / event->name;
+            if (!DataProcessor::isInputFile(path)) continue;
+            try {
+                if (event->wd == corpus_wd) {
+                    auto started = std::chrono::steady_clock::now();
+                    corpus->reloadFile(path.string());
+                    std::cerr << "Reloaded " << path.filename().string() << " in " << millisecondsSince(started) << " ms" << std::endl;
+                } else {
+                    std::string stem = path.stem().string();
+                    if (stem.size() >= 8 && stem.compare(stem.size() - 8, 8, "_Matches") == 0) continue;
+                    matchDroppedFile(*corpus, session, path.string());
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error occurred: " << path.filename().string() << ": " << e.what() << std::endl;
+            }
+        }
+    }
+    close(fd);
+    return 0;
+#else
+    std::cerr << "watch mode needs Linux inotify" << std::endl;
+    return 1;
+#endif
+}
+
+// Answers by-date / by-player / by-pattern questions from a saved hit matrix
+int runQuery(const std::vector<std::string>& args) {
+    std::string matrix_path;
+    std::string date_filter;
+    std::string player_filter;
+    bool has_pattern = false;
+    uint64_t pattern_filter = 0;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--date" && i + 1 < args.size()) {
+            date_filter = args[++i];
+        } else if (args[i] == "--player" && i + 1 < args.size()) {
+            player_filter = args[++i];
+        } else if (args[i] == "--pattern" && i + 1 < args.size()) {
+            pattern_filter = countOption(args[i], args[i + 1]);
+            has_pattern = true;
+            ++i;
+        } else {
+            matrix_path = args[i];
+        }
+    }
+    if (matrix_path.empty()) {
+        std::cerr << "Usage: query <hit_matrix> [--date TEXT] [--player NAME] [--pattern ID]" << std::endl;
+        return 1;
+    }
+    
+    auto started = std::chrono::steady_clock::now();
+    HitMatrix matrix = HitMatrix::load(matrix_path);
+    
+    // Days whose label contains the --date text, e.g. "072025" for a month
+    std::vector<size_t> days;
+    for (size_t d = 0; d < matrix.days.size(); ++d) {
+        if (matrix.days[d].find(date_filter) != std::string::npos) days.push_back(d);
+    }
+    auto patternInfo = [&](uint32_t id) {
+        const HitMatrix::FileEntry& file = matrix.fileOf(id);
+        return std::to_string(id) + "," + file.name + "," + std::to_string(id - file.first_pattern) + "," +
+               matrix.players[matrix.pattern_players[id]];
+    };
+    
+    if (has_pattern) {
+        if (pattern_filter >= matrix.patternCount()) {
+            std::cerr << "Unknown pattern id: " << pattern_filter << std::endl;
+            return 1;
+        }
+        uint32_t id = static_cast<uint32_t>(pattern_filter);
+        std::cout << "pattern,file,row,player,day" << std::endl;
+        for (size_t d : days) {
+            if (matrix.hits[d].contains(id)) std::cout << patternInfo(id) << "," << matrix.days[d] << "\n";
+        }
+    } else if (!player_filter.empty()) {
+        auto player_it = std::find(matrix.players.begin(), matrix.players.end(), player_filter);
+        if (player_it == matrix.players.end()) {
+            std::cerr << "Unknown player: " << player_filter << std::endl;
+            return 1;
+        }
+        int32_t player = static_cast<int32_t>(player_it - matrix.players.begin());
+        std::vector<uint32_t> patterns;
+        for (size_t id = 0; id < matrix.patternCount(); ++id) {
+            if (matrix.pattern_players[id] == player) patterns.push_back(static_cast<uint32_t>(id));
+        }
+        std::vector<uint32_t> pattern_hits(patterns.size(), 0);
+        std::cout << "day,patterns_hit" << std::endl;
+        for (size_t d : days) {
+            uint32_t day_hits = 0;
+            for (size_t p = 0; p < patterns.size(); ++p) {
+                if (matrix.hits[d].contains(patterns[p])) {
+                    day_hits++;
+                    pattern_hits[p]++;
+                }
+            }
+            std::cout << matrix.days[d] << "," << day_hits << "\n";
+        }
+        std::cout << "pattern,file,row,player,days_hit" << std::endl;
+        for (size_t p = 0; p < patterns.size(); ++p) {
+            if (pattern_hits[p] > 0) std::cout << patternInfo(patterns[p]) << "," << pattern_hits[p] << "\n";
+        }
+    } else if (!date_filter.empty()) {
+        std::cout << "day,pattern,file,row,player" << std::endl;
+        for (size_t d : days) {
+            matrix.hits[d].forEach([&](uint32_t id) {
+                std::cout << matrix.days[d] << "," << patternInfo(id) << "\n";
+            });
+        }
+    } else {
+        std::cout << "day,patterns_hit" << std::endl;
+        for (size_t d : days) {
+            std::cout << matrix.days[d] << "," << matrix.hits[d].cardinality() << "\n";
+        }
+    }
+    
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started);
+    std::cerr << "Query answered in " << elapsed.count() << " ms (" << matrix.days.size() << " days, "
+              << matrix.patternCount() << " patterns)" << std::endl;
+    return 0;
+}
+
+// Rebuilds <daily>_Matches.csv from a --normalized <daily>_Matches folder
+int runExpand(const std::vector<std::string>& args) {
+    if (args.empty() || args.size() > 2) {
+        std::cerr << "Usage: expand <matches_folder> [output_csv]" << std::endl;
+        return 1;
+    }
+    std::string folder = args[0];
+    while (folder.size() > 1 && (folder.back() == '/' || folder.back() == '\\')) folder.pop_back();
+    std::string output_path = args.size() > 1 ? args[1] : folder + ".csv";
+    size_t count = NormalizedOutput::expand(folder, output_path);
+    std::cout << "Expanded " << count << " matches to: " << output_path << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    try {
+        g_pattern_filter = takeFilterOptions(args);
+    } catch (const std::exception& e) {
+        std::cerr << "Error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    g_executable = std::filesystem::exists("/proc/self/exe") ? std::filesystem::read_symlink("/proc/self/exe").string() : argv[0];
+    const std::map<std::string, int (*)(const std::vector<std::string>&)> commands = {
+        {"query", runQuery},
+        {"watch", runWatch},
+        {"serve", runServe},
+        {"client", runClient},
+        {"shard", runShard},
+        {"worker", runWorker},
+        {"expand", runExpand},
+    };
+    if (!args.empty() && commands.count(args[0])) {
+        std::signal(SIGINT, onInterrupt);
+        std::vector<std::string> command_args(args.begin() + 1, args.end());
+        try {
+            return commands.at(args[0])(command_args);
+        } catch (const std::exception& e) {
+            std::cerr << "Error occurred: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    DataProcessor::RunOptions options;
+    options.filter = g_pattern_filter;
+    size_t thread_count = THREAD_NUM;
+    bool stream = false;
+    std::vector<std::string> positional;
+    try {
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--hit-matrix" && i + 1 < args.size()) {
+                options.hit_matrix_path = args[++i];
+            } else if (args[i] == "--threads" && i + 1 < args.size()) {
+                thread_count = countOption(args[i], args[i + 1]);
+                ++i;
+            } else if (args[i] == "--trace" && i + 1 < args.size()) {
+                options.trace_path = args[++i];
+            } else if (args[i] == "--metrics" && i + 1 < args.size()) {
+                options.metrics_path = args[++i];
+            } else if (args[i] == "--perf") {
+                options.hardware_counters = true;
+            } else if (args[i] == "--memory-budget" && i + 1 < args.size()) {
+                options.memory_budget = countOption(args[i], args[i + 1]) * 1024 * 1024;
+                ++i;
+            } else if (args[i] == "--no-zone-index") {
+                options.zone_index = false;
+            } else if (args[i] == "--cache-dir" && i + 1 < args.size()) {
+                options.cache_dir = args[++i];
+            } else if (args[i] == "--summary") {
+                options.summary = true;
+            } else if (args[i] == "--top" && i + 1 < args.size()) {
+                options.top_k = static_cast<uint32_t>(countOption(args[i], args[i + 1]));
+                ++i;
+            } else if (args[i] == "--normalized") {
+                options.normalized = true;
+            } else if (args[i] == "--match-set") {
+                options.match_set = true;
+            } else if (args[i] == "--delta" && i + 1 < args.size()) {
+                options.previous_match_set = args[++i];
+            } else if (args[i] == "--time-budget" && i + 1 < args.size()) {
+                options.time_budget_seconds = numberOption(args[i], args[i + 1]);
+                ++i;
+            } else if (args[i] == "--stream") {
+                stream = true;
+            } else if (args[i] == "--checkpoint" && i + 1 < args.size()) {
+                options.checkpoint_dir = args[++i];
+            } else if (args[i] == "--result-cache") {
+                options.result_cache = true;
+            } else {
+                positional.push_back(args[i]);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    if (positional.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--threads N] [--hit-matrix FILE] [--trace FILE] [--metrics FILE] [--perf] [--memory-budget MB] [--no-zone-index] [--cache-dir DIR] [--summary] [--top K] [--normalized] [--match-set] [--delta PREVIOUS_MATCHSET] [--time-budget SECONDS] [--stream] [--checkpoint DIR] [--result-cache] <daily_file_or_folder>... <historical_folder>" << std::endl;
+        std::cerr << "       " << argv[0] << " query <hit_matrix> [--date TEXT] [--player NAME] [--pattern ID]" << std::endl;
+        std::cerr << "       " << argv[0] << " watch <historical_folder> <drop_folder>" << std::endl;
+        std::cerr << "       " << argv[0] << " serve <historical_folder> <socket_path>" << std::endl;
+        std::cerr << "       " << argv[0] << " client <socket_path> <daily_file | --stats>" << std::endl;
+        std::cerr << "       " << argv[0] << " shard [--workers N] [--by size|player] <daily_file> <historical_folder>" << std::endl;
+        std::cerr << "       " << argv[0] << " expand <matches_folder> [output_csv]" << std::endl;
+        std::cerr << "Any command: [--min-total N] [--min-win-percent F] [--max-rows-per-player N] drop weaker historical rows" << std::endl;
+        return 1;
+    }
+    if (!options.trace_path.empty() && !traceEnabled()) {
+        std::cerr << "Error occurred: --trace needs a build with -DMATCHER_TRACE" << std::endl;
+        return 1;
+    }
+    
+    DataProcessor processor;
+    processor.setThreadCount(thread_count);
+    g_processor = &processor;
+    std::signal(SIGINT, onInterrupt);
+    
+    // Several daily files (or folders of them) share one pass over the corpus
+    std::vector<std::string> daily_inputs(positional.begin(), positional.end() - 1);
+    std::string historical_folder = positional.back();
+    // Matches go to stdout as each file is done (a "# <daily file>" line
+    // starts each day's block); the run's own messages move to stderr
+    std::string streamed_daily;
+    if (stream) {
+        options.on_matches = [&streamed_daily](const std::string& daily_file, const std::string& rows) {
+            if (daily_file != streamed_daily) {
+                streamed_daily = daily_file;
+                std::cout << "# " << daily_file << "\n";
+            }
+            std::cout << rows << std::flush;
+        };
+    }
+    std::ostream& report = stream ? std::cerr : std::cout;
+    auto run = std::async(std::launch::async, [&]() {
+        return processor.processBatch(daily_inputs, historical_folder, options);
+    });
+    // Sample the engine counters; the workers never wait on this loop
+    while (run.wait_for(std::chrono::milliseconds(500)) != std::future_status::ready) {
+        std::cerr << "\r" << formatProgress(processor.getProgress()) << std::flush;
+    }
+    std::cerr << "\r" << formatProgress(processor.getProgress()) << std::endl;
+    
+    try {
+        std::vector<DataProcessor::RunResult> results = run.get();
+        if (results.empty()) {
+            report << "NO daily files found..." << std::endl;
+            return 1;
+        }
+        if (results.front().cancelled) {
+            report << "Processing cancelled." << std::endl;
+            return 130;
+        }
+        for (const auto& result : results) {
+            if (result.partial) {
+                report << "Time budget spent; partial results, coverage in: " << result.coverage_path << std::endl;
+            }
+            if (result.output_path.empty()) {
+                report << "NO Matches found..." << std::endl;
+            } else {
+                report << "Processing finished. Results saved to: " << result.output_path
+                       << " (" << result.match_count << " matches)" << std::endl;
+            }
+        }
+        if (options.hardware_counters) {
+            std::cerr << "Hardware counters: "
+                      << processor.getHardwareProfile().toJson(processor.getProgress().rows_scanned.load()) << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    g_processor = nullptr;
+    return 0;
+}
+#endif
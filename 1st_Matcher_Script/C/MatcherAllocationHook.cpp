@@ -0,0 +1,32 @@
+// Replaces the global operator new so metrics can report allocations per
+// engine stage. Opt-in: link it into Matcher.exe or MatcherBench.exe next to
+// the program's own source. Leave it out of anything that shares the process
+// with other code, such as the Python module.
+
+#include "MatcherEngine.hpp"
+
+namespace {
+struct HookInstalled {
+    HookInstalled() { g_allocation_hook.store(true, std::memory_order_relaxed); }
+} hook_installed;
+}
+
+// Kept out of line: GCC's -Wmismatched-new-delete misfires when it inlines
+// free() from these into code whose pointer came from operator new
+#ifdef __GNUC__
+#define MATCHER_ALLOCATION_FUNCTION __attribute__((noinline))
+#else
+#define MATCHER_ALLOCATION_FUNCTION
+#endif
+
+MATCHER_ALLOCATION_FUNCTION void* operator new(std::size_t size) {
+    g_allocation_counters.count[g_allocation_stage].add(1);
+    g_allocation_counters.bytes[g_allocation_stage].add(size);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+MATCHER_ALLOCATION_FUNCTION void* operator new[](std::size_t size) { return operator new(size); }
+MATCHER_ALLOCATION_FUNCTION void operator delete(void* memory) noexcept { std::free(memory); }
+MATCHER_ALLOCATION_FUNCTION void operator delete[](void* memory) noexcept { std::free(memory); }
+MATCHER_ALLOCATION_FUNCTION void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+MATCHER_ALLOCATION_FUNCTION void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
@@ -0,0 +1,452 @@
+#include "MatcherEngine.hpp"
+#include <random>
+#include <regex>
+#include <iomanip>
+
+// Benchmarks for the matching engine: a deterministic generator for
+// historical folders and daily slates, micro-benchmarks of the hot paths,
+// and end-to-end runs across corpus scales and thread counts. Results are
+// written as JSON so builds can be compared.
+
+// Draws straight from mt19937_64: std distributions differ between standard
+// libraries and the corpus must be identical everywhere for a given seed.
+class SyntheticRandom {
+public:
+    explicit SyntheticRandom(uint64_t seed) : engine(seed) {}
+
+    uint64_t below(uint64_t n) { return engine() % n; }
+    double unit() { return (engine() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Index drawn with the given relative weights
+    size_t weighted(const std::vector<double>& weights) {
+        double total = 0;
+        for (double w : weights) total += w;
+        double pick = unit() * total;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            if (pick < weights[i]) return i;
+            pick -= weights[i];
+        }
+        return weights.size() - 1;
+    }
+
+private:
+    std::mt19937_64 engine;
+};
+
+const std::vector<std::string> signs = {
+    "Aries", "Taurus", "Gemini", "Cancer", "Leo", "Virgo",
+    "Libra", "Scorpio", "Sagittarius", "Capricorn", "Aquarius", "Pisces"
+};
+
+// Sign frequencies of the letter-A sample (outer planets crowd a few signs)
+const std::vector<double> sign_weights = {134, 164, 156, 151, 142, 137, 80, 42, 42, 43, 37, 50};
+
+const std::vector<std::string> degree_buckets = {
+    "000-004", "005-008", "009-012", "013-016", "017-020", "021-024", "025-029"
+};
+
+const size_t letter_a_files = 57;
+
+std::string playerName(size_t index) {
+    char name[32];
+    snprintf(name, sizeof(name), "player-%04zu", index);
+    return name;
+}
+
+// A player's recurring placements: historical rows repeat them often enough
+// that a slate built from the same chart produces a realistic number of matches
+struct PlayerChart {
+    size_t sign[11];
+    int degree[11];
+};
+
+PlayerChart chartFor(size_t player, uint64_t seed) {
+    SyntheticRandom random(seed ^ (0x9E3779B97F4A7C15ull * (player + 1)));
+    PlayerChart chart;
+    for (size_t planet = 0; planet < 11; ++planet) {
+        chart.sign[planet] = random.weighted(sign_weights);
+        chart.degree[planet] = static_cast<int>(random.below(30));
+    }
+    return chart;
+}
+
+size_t bucketOf(int degree) {
+    return degree < 5 ? 0 : std::min<size_t>((degree - 5) / 4 + 1, degree_buckets.size() - 1);
+}
+
+const double chart_repeat = 0.6;
+
+// Formats like Python's str(round(x, 2)): "0.0", "1.0", "0.5", "0.33"
+std::string formatWinPercent(double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.2f", value);
+    std::string result = text;
+    while (result.back() == '0' && result[result.size() - 2] != '.') result.pop_back();
+    return result;
+}
+
+// Writes a historical folder shaped like Single_Players_to07122025_7pies4_Grouped_output_001:
+// one file per player, each row four (sign, degree bucket) planet pairs followed
+// by Total and WinPercent, mostly "1,0.0". Returns the number of rows written.
+size_t generateHistoricalFolder(const std::string& folder, double scale, uint64_t seed) {
+    SyntheticRandom random(seed);
+    std::filesystem::create_directories(folder);
+    size_t file_count = std::max<size_t>(1, static_cast<size_t>(std::lround(letter_a_files * scale)));
+    size_t total_rows = 0;
+    std::string text;
+    for (size_t f = 0; f < file_count; ++f) {
+        std::string player = playerName(f);
+        PlayerChart chart = chartFor(f, seed);
+        size_t rows = 900 + random.below(40000);
+        text.clear();
+        for (size_t r = 0; r < rows; ++r) {
+            // Four distinct planets out of eleven, in column order
+            std::vector<size_t> planets;
+            while (planets.size() < 4) {
+                size_t planet = random.below(11);
+                if (std::find(planets.begin(), planets.end(), planet) == planets.end()) planets.push_back(planet);
+            }
+            std::sort(planets.begin(), planets.end());
+
+            text += player;
+            for (size_t planet : planets) {
+                size_t sign = random.unit() < chart_repeat ? chart.sign[planet] : random.weighted(sign_weights);
+                size_t bucket = random.unit() < chart_repeat ? bucketOf(chart.degree[planet]) : random.below(degree_buckets.size());
+                text += ',' + daily_cols[planet * 2] + ',' + signs[sign];
+                text += ',' + daily_cols[planet * 2 + 1] + ',' + degree_buckets[bucket];
+            }
+
+            int total = 1;
+            while (total < 60 && random.unit() < 0.42) total++;
+            int wins = 0;
+            for (int t = 0; t < total; ++t) {
+                if (random.unit() < 0.1) wins++;
+            }
+            text += ',' + std::to_string(total) + ',' + formatWinPercent(static_cast<double>(wins) / total) + '\n';
+        }
+        std::ofstream out(folder + "/split_A_" + player + "_Size_4_Degree_YES.csv", std::ios::binary);
+        out << text;
+        total_rows += rows;
+    }
+    return total_rows;
+}
+
+// Writes a 63-column daily slate. About a third of the players have a
+// historical file, as in the sample daily file, and appear with their chart.
+void generateDailySlate(const std::string& path, size_t corpus_files, size_t players, uint64_t seed) {
+    std::ofstream out(path, std::ios::binary);
+    for (size_t p = 0; p < players; ++p) {
+        bool in_corpus = p % 3 == 0 && p / 3 < corpus_files;
+        std::string row = in_corpus ? playerName(p / 3) : "daily-only-" + std::to_string(p);
+        PlayerChart chart = in_corpus ? chartFor(p / 3, seed) : chartFor(corpus_files + p, seed);
+        for (int c = 1; c <= 40; ++c) row += ",info" + std::to_string(c);
+        for (size_t planet = 0; planet < 11; ++planet) {
+            char degree[8];
+            snprintf(degree, sizeof(degree), "%03d", chart.degree[planet]);
+            row += ',' + signs[chart.sign[planet]] + ',' + degree;
+        }
+        out << row << '\n';
+    }
+}
+
+// Legacy degreeMatch, kept as the baseline the compiled check is compared to
+bool regexDegreeMatch(const std::string& daily_val, const std::string& hist_range) {
+    try {
+        std::regex range_regex(R"((\d+)-(\d+))");
+        std::smatch matches;
+        if (std::regex_match(hist_range, matches, range_regex)) {
+            int low = std::stoi(matches[1]);
+            int high = std::stoi(matches[2]);
+            int daily_int = std::stoi(daily_val);
+            return daily_int >= low && daily_int <= high;
+        }
+        return false;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Results of benchmarked loops land here so they cannot be optimized away
+volatile size_t bench_sink = 0;
+
+struct BenchResult {
+    std::string name;
+    uint64_t operations = 0;    // Items processed
+    uint64_t bytes = 0;         // Bytes processed, 0 when not meaningful
+    double seconds = 0;
+
+    std::string toJson() const {
+        std::ostringstream json;
+        json << std::setprecision(6) << "{\"name\": \"" << jsonEscape(name) << "\", \"operations\": " << operations
+             << ", \"seconds\": " << seconds << ", \"ns_per_op\": " << (operations ? seconds * 1e9 / operations : 0)
+             << ", \"ops_per_sec\": " << (seconds > 0 ? operations / seconds : 0);
+        if (bytes > 0) json << ", \"mb_per_sec\": " << (seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0);
+        json << "}";
+        return json.str();
+    }
+};
+
+// Repeats fn until at least min_seconds have passed; fn returns (operations, bytes)
+template <typename Fn>
+BenchResult measure(const std::string& name, double min_seconds, Fn&& fn) {
+    BenchResult result;
+    result.name = name;
+    auto started = std::chrono::steady_clock::now();
+    do {
+        std::pair<uint64_t, uint64_t> work = fn();
+        result.operations += work.first;
+        result.bytes += work.second;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    } while (result.seconds < min_seconds);
+    std::cerr << "  " << result.toJson() << std::endl;
+    return result;
+}
+
+std::vector<BenchResult> runMicroBenchmarks(const std::string& folder, const std::string& daily_file, double min_seconds) {
+    std::vector<BenchResult> results;
+    std::vector<std::string> files = DataProcessor::listHistoricalFiles(folder);
+    std::string largest = *std::max_element(files.begin(), files.end(), [](const std::string& a, const std::string& b) {
+        return std::filesystem::file_size(a) < std::filesystem::file_size(b);
+    });
+    uint64_t largest_bytes = std::filesystem::file_size(largest);
+    DataFrame rows = CSVReader::readCSV(largest);
+    std::string line;
+    std::getline(std::ifstream(largest), line);
+
+    results.push_back(measure("csv_read_file", min_seconds, [&]() {
+        return std::pair<uint64_t, uint64_t>(CSVReader::readCSV(largest).size(), largest_bytes);
+    }));
+    results.push_back(measure("csv_parse_line", min_seconds, [&]() {
+        for (int i = 0; i < 10000; ++i) CSVReader::parseCSVLine(line);
+        return std::pair<uint64_t, uint64_t>(10000, 10000 * line.size());
+    }));
+
+    // degreeMatch equivalents over every degree cell of the file
+    std::vector<std::string> ranges;
+    for (const Row& row : rows) {
+        for (size_t i = 2; i + 2 < row.size(); i += 4) ranges.push_back(row[i]);
+    }
+    results.push_back(measure("degree_match_regex", min_seconds, [&]() {
+        size_t hits = 0;
+        for (size_t i = 0; i < std::min<size_t>(ranges.size(), 20000); ++i) hits += regexDegreeMatch("14", ranges[i]);
+        bench_sink = bench_sink + hits;
+        return std::pair<uint64_t, uint64_t>(std::min<size_t>(ranges.size(), 20000), 0);
+    }));
+    results.push_back(measure("degree_match_compiled", min_seconds, [&]() {
+        size_t hits = 0;
+        for (const std::string& range : ranges) {
+            int low = 0;
+            int high = 0;
+            hits += DataProcessor::parseDegreeRange(range, low, high) && 14 >= low && 14 <= high;
+        }
+        bench_sink = bench_sink + hits;
+        return std::pair<uint64_t, uint64_t>(ranges.size(), 0);
+    }));
+
+    DataProcessor engine;
+    engine.setThreadCount(1);
+    std::vector<DailySlate> slates;
+    slates.push_back(engine.compileDailySlate(daily_file, CSVReader::readCSV(daily_file)));
+    results.push_back(measure("compile_file", min_seconds, [&]() {
+        return std::pair<uint64_t, uint64_t>(engine.compileRows(rows).patterns.size(), 0);
+    }));
+
+    // The match kernel: every pattern checked against a slate where every
+    // pattern's player is present, so no pattern is skipped by the player key
+    CompiledFile file = engine.compileRows(rows);
+    DataFrame kernel_daily = CSVReader::readCSV(daily_file);
+    for (Row& row : kernel_daily) row[0] = rows.front()[0];
+    std::vector<DailySlate> kernel_slates;
+    kernel_slates.push_back(engine.compileDailySlate(daily_file, kernel_daily));
+    size_t kernel_patterns = std::min<size_t>(file.patterns.size(), 2000);
+    results.push_back(measure("match_kernel_pattern_x_row", min_seconds, [&]() {
+        engine.processChunk(file, 0, kernel_patterns, kernel_slates);
+        return std::pair<uint64_t, uint64_t>(kernel_patterns * kernel_daily.size(), 0);
+    }));
+
+    // Writers: the legacy DataFrame writer and the pre-rendered row path
+    DataFrame wide_rows;
+    Row daily_row = CSVReader::readCSV(daily_file).front();
+    for (size_t i = 0; i < std::min<size_t>(rows.size(), 20000); ++i) {
+        Row matched = daily_row;
+        matched.insert(matched.end(), rows[i].begin(), rows[i].end());
+        wide_rows.push_back(matched);
+    }
+    std::string writer_path = folder + "/../bench_writer.csv";
+    results.push_back(measure("write_csv_dataframe", min_seconds, [&]() {
+        CSVReader::writeCSV(wide_rows, writer_path);
+        return std::pair<uint64_t, uint64_t>(wide_rows.size(), std::filesystem::file_size(writer_path));
+    }));
+    results.push_back(measure("write_csv_prerendered", min_seconds, [&]() {
+        std::string rendered_daily;
+        CSVReader::appendCSVRow(rendered_daily, daily_row);
+        std::string buffer;
+        for (size_t i = 0; i < wide_rows.size(); ++i) {
+            buffer += rendered_daily;
+            buffer += ',';
+            buffer += file.rowText(file.patterns[i]);
+            buffer += '\n';
+        }
+        std::ofstream(writer_path) << buffer;
+        return std::pair<uint64_t, uint64_t>(wide_rows.size(), buffer.size());
+    }));
+    std::filesystem::remove(writer_path);
+    return results;
+}
+
+struct EndToEndResult {
+    double scale;
+    size_t threads;
+    uint64_t rows;
+    uint64_t bytes;
+    size_t matches;
+    double seconds;
+    double speedup;     // Against the first (smallest) thread count
+
+    std::string toJson() const {
+        std::ostringstream json;
+        json << std::setprecision(6) << "{\"scale\": " << scale << ", \"threads\": " << threads << ", \"rows\": " << rows
+             << ", \"bytes\": " << bytes << ", \"matches\": " << matches << ", \"seconds\": " << seconds
+             << ", \"rows_per_sec\": " << rows / seconds << ", \"mb_per_sec\": " << bytes / seconds / (1024.0 * 1024.0)
+             << ", \"speedup\": " << speedup << ", \"efficiency\": " << speedup * thread_base / threads << "}";
+        return json.str();
+    }
+
+    size_t thread_base = 1;
+};
+
+std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) values.push_back(std::stod(item));
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    std::string work_dir = "bench_data";
+    std::string output_path;
+    std::vector<double> scales = {1, 10, 30};
+    std::vector<double> thread_counts = {1, 2, 4, 8};
+    uint64_t seed = 20250712;
+    double min_seconds = 0.5;
+    bool micro = true;
+    bool end_to_end = true;
+    bool generate_only = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--work" && i + 1 < argc) {
+            work_dir = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg == "--scales" && i + 1 < argc) {
+            scales = parseList(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            thread_counts = parseList(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            min_seconds = std::stod(argv[++i]);
+        } else if (arg == "--generate-only") {
+            generate_only = true;
+        } else if (arg == "--micro-only") {
+            end_to_end = false;
+        } else if (arg == "--end-to-end-only") {
+            micro = false;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--work DIR] [--out FILE] [--scales 1,10,30] [--threads 1,2,4,8]"
+                      << " [--seed N] [--min-time SECONDS] [--micro-only | --end-to-end-only | --generate-only]" << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        // Corpora are generated once per (scale, seed) and reused by later runs
+        auto corpusFor = [&](double scale) {
+            std::ostringstream name;
+            name << work_dir << "/corpus_x" << scale << "_seed" << seed;
+            std::string folder = name.str();
+            std::string daily_file = folder + "_daily.csv";
+            if (!std::filesystem::exists(folder + "/.complete")) {
+                std::cerr << "Generating " << folder << "..." << std::endl;
+                std::filesystem::remove_all(folder);
+                generateHistoricalFolder(folder, scale, seed);
+                std::ofstream(folder + "/.complete") << "ok\n";
+            }
+            size_t files = std::max<size_t>(1, static_cast<size_t>(std::lround(letter_a_files * scale)));
+            generateDailySlate(daily_file, files, 116, seed);
+            return std::make_pair(folder, daily_file);
+        };
+
+        // Corpus paths only, one "folder<TAB>daily" line per scale, for the differential harness
+        if (generate_only) {
+            for (double scale : scales) {
+                auto [folder, daily_file] = corpusFor(scale);
+                std::cout << folder << '\t' << daily_file << std::endl;
+            }
+            return 0;
+        }
+
+        std::vector<BenchResult> micro_results;
+        if (micro) {
+            std::cerr << "Micro-benchmarks" << std::endl;
+            auto [folder, daily_file] = corpusFor(scales.front());
+            micro_results = runMicroBenchmarks(folder, daily_file, min_seconds);
+        }
+
+        std::vector<EndToEndResult> e2e_results;
+        if (end_to_end) {
+            for (double scale : scales) {
+                auto [folder, daily_file] = corpusFor(scale);
+                std::cerr << "End-to-end x" << scale << std::endl;
+                double base_seconds = 0;
+                for (double threads : thread_counts) {
+                    DataProcessor processor;
+                    processor.setThreadCount(static_cast<size_t>(threads));
+                    auto started = std::chrono::steady_clock::now();
+                    DataProcessor::RunResult run = processor.processFiles(daily_file, folder);
+                    EndToEndResult result;
+                    result.scale = scale;
+                    result.threads = static_cast<size_t>(threads);
+                    result.thread_base = static_cast<size_t>(thread_counts.front());
+                    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+                    result.rows = processor.getProgress().rows_scanned.load();
+                    result.bytes = processor.getProgress().bytes_read.load();
+                    result.matches = run.match_count;
+                    if (base_seconds == 0) base_seconds = result.seconds;
+                    result.speedup = base_seconds / result.seconds;
+                    if (!run.output_path.empty()) std::filesystem::remove(run.output_path);
+                    std::filesystem::remove(DataProcessor::metricsPathFor(daily_file));
+                    std::cerr << "  " << result.toJson() << std::endl;
+                    e2e_results.push_back(result);
+                }
+            }
+        }
+
+        std::ostringstream json;
+        json << "{\n  \"build\": {\"compiler\": \"" << jsonEscape(__VERSION__) << "\", \"thread_num\": " << THREAD_NUM
+             << ", \"hardware_threads\": " << std::thread::hardware_concurrency() << ", \"seed\": " << seed << "},\n";
+        json << "  \"micro\": [";
+        for (size_t i = 0; i < micro_results.size(); ++i) {
+            json << (i ? ",\n    " : "\n    ") << micro_results[i].toJson();
+        }
+        json << "\n  ],\n  \"end_to_end\": [";
+        for (size_t i = 0; i < e2e_results.size(); ++i) {
+            json << (i ? ",\n    " : "\n    ") << e2e_results[i].toJson();
+        }
+        json << "\n  ]\n}\n";
+
+        if (output_path.empty()) {
+            std::cout << json.str();
+        } else {
+            std::ofstream(output_path) << json.str();
+            std::cerr << "Results written to " << output_path << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,4280 @@
+#pragma once
+
+// Matching engine shared by Matcher.cpp (GUI and command line) and MatcherBench.cpp
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <unordered_map> // Added for faster lookup
+#include <array>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <shared_mutex>
+#include <memory>
+#include <functional>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <tuple>
+#include <xlnt/xlnt.hpp> // Add this include for xlnt
+#ifdef MATCHER_WITH_ZLIB
+#include <zlib.h>           // .csv.gz / .csv.zz inputs; link with -lz
+#endif
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#define THREAD_NUM 8
+
+// CSV/Excel-like data structure
+using Row = std::vector<std::string>;
+using DataFrame = std::vector<Row>;
+
+// Column definitions
+const std::vector<std::string> daily_cols = {
+    "AP", "AQ", "AR", "AS", "AT", "AU", "AV", "AW", "AX", "AY", "AZ", 
+    "BA", "BB", "BC", "BD", "BE", "BF", "BG", "BH", "BI", "BJ", "BK"
+};
+
+const std::vector<std::string> degree_cols = {
+    "AQ", "AS", "AU", "AW", "AY", "BA", "BC", "BE", "BG", "BI", "BK"
+};
+
+// Counter on its own cache line so workers bumping different counters
+// never share a line. Relaxed ordering: readers only sample for display.
+struct alignas(64) PaddedCounter {
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+    void store(uint64_t n) { value.store(n, std::memory_order_relaxed); }
+    uint64_t load() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Set by the GUI/CLI, polled by the workers between batches of rows
+class CancellationToken {
+public:
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    void reset() { cancelled.store(false, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+private:
+    alignas(64) std::atomic<bool> cancelled{false};
+};
+
+// Progress published by the engine. Workers only ever write these counters;
+// the front-ends sample them on their own schedule (WM_TIMER / CLI loop).
+struct EngineProgress {
+    PaddedCounter rows_scanned;
+    PaddedCounter files_done;
+    PaddedCounter files_total;
+    PaddedCounter matches_found;
+    PaddedCounter bytes_read;
+    PaddedCounter row_errors;
+    PaddedCounter patterns_evaluated;   // Pattern x daily row checks
+
+    void reset() {
+        rows_scanned.store(0);
+        files_done.store(0);
+        files_total.store(0);
+        matches_found.store(0);
+        bytes_read.store(0);
+        row_errors.store(0);
+        patterns_evaluated.store(0);
+    }
+};
+
+inline std::string formatProgress(const EngineProgress& progress) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+             "Files %llu/%llu | rows %llu | matches %llu | %.1f MB read",
+             static_cast<unsigned long long>(progress.files_done.load()),
+             static_cast<unsigned long long>(progress.files_total.load()),
+             static_cast<unsigned long long>(progress.rows_scanned.load()),
+             static_cast<unsigned long long>(progress.matches_found.load()),
+             progress.bytes_read.load() / (1024.0 * 1024.0));
+    if (progress.row_errors.load() > 0) {
+        return std::string(buffer) + " | " + std::to_string(progress.row_errors.load()) + " row errors";
+    }
+    return buffer;
+}
+
+// Allocation accounting. Programs that link MatcherAllocationHook.cpp get a
+// global operator new charging every allocation to the stage the allocating
+// thread is in (see AllocationScope); elsewhere the counters stay at zero.
+enum AllocationStage { ALLOC_OTHER, ALLOC_DAILY, ALLOC_PARSE, ALLOC_COMPILE, ALLOC_MATCH, ALLOC_WRITE, ALLOC_STAGE_COUNT };
+
+struct AllocationCounters {
+    PaddedCounter count[ALLOC_STAGE_COUNT];
+    PaddedCounter bytes[ALLOC_STAGE_COUNT];
+};
+
+inline AllocationCounters g_allocation_counters;
+inline thread_local int g_allocation_stage = ALLOC_OTHER;
+inline std::atomic<bool> g_allocation_hook{false};     // Set by MatcherAllocationHook.cpp
+
+inline bool allocationTracking() { return g_allocation_hook.load(std::memory_order_relaxed); }
+
+// Charges the calling thread's allocations to a stage for the enclosing scope
+class AllocationScope {
+public:
+    explicit AllocationScope(AllocationStage stage) : previous(g_allocation_stage) { g_allocation_stage = stage; }
+    ~AllocationScope() { g_allocation_stage = previous; }
+
+private:
+    int previous;
+};
+
+// Peak resident set size of the process. On Linux the peak is reset at the
+// start of each run, so a long-lived process reports the run's own peak.
+inline void resetPeakResident() {
+#ifdef __linux__
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (clear_refs.is_open()) clear_refs << "5";
+#endif
+}
+
+inline uint64_t peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+    return 0;
+#else
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::stoull(line.substr(6)) * 1024;
+    }
+#endif
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Heap bytes held by a string beyond the object itself (libstdc++ keeps up
+// to 15 characters inline)
+inline size_t heapBytes(const std::string& text) {
+    return text.capacity() > 15 ? text.capacity() + 1 : 0;
+}
+
+inline size_t dataFrameFootprint(const DataFrame& data) {
+    size_t bytes = data.capacity() * sizeof(Row);
+    for (const Row& row : data) {
+        bytes += row.capacity() * sizeof(std::string);
+        for (const std::string& cell : row) bytes += heapBytes(cell);
+    }
+    return bytes;
+}
+
+// Control characters (a newline or tab in a file or player name) become
+// \u00XX; JSON strings may not hold them raw
+inline std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char code[7];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+            escaped += code;
+            continue;
+        }
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+#ifdef MATCHER_TRACE
+// Scoped trace events for a Chrome/Perfetto timeline (chrome://tracing,
+// ui.perfetto.dev). Compiled in with -DMATCHER_TRACE; otherwise TRACE_SCOPE
+// expands to nothing and its arguments are never evaluated.
+// Each thread records into a ring of its own, so recording takes no lock.
+// Rings of finished threads are handed to the next new thread, which keeps
+// the std::async workers of consecutive files on a few timeline tracks.
+class TraceRecorder {
+public:
+    struct Event {
+        const char* name;       // String literal
+        uint64_t begin_ns;
+        uint64_t end_ns;
+        char detail[48];        // File name etc., truncated
+    };
+    
+    static TraceRecorder& instance() {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+    
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+    
+    // Claims a ring for the calling thread, so threads that are running
+    // concurrently never share a timeline track
+    void attachThread() { localRing(); }
+    
+    void record(const char* name, uint64_t begin_ns, const std::string& detail) {
+        ThreadRing& ring = localRing();
+        uint64_t written = ring.written.load(std::memory_order_relaxed);
+        Event& event = ring.events[written % ring_capacity];
+        event.name = name;
+        event.begin_ns = begin_ns;
+        event.end_ns = now();
+        size_t length = std::min(detail.size(), sizeof(event.detail) - 1);
+        memcpy(event.detail, detail.data(), length);
+        event.detail[length] = '\0';
+        ring.written.store(written + 1, std::memory_order_release);
+    }
+    
+    // Drops recorded events; only call while no traced work is running
+    void clear() {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto& ring : rings) ring->written.store(0, std::memory_order_relaxed);
+    }
+    
+    // Writes every ring as Chrome trace JSON, one track per ring. Call once
+    // the traced work has finished.
+    void write(const std::string& path) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            throw std::runtime_error("Cannot create file: " + path);
+        }
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        char line[512];
+        for (const auto& ring : rings) {
+            snprintf(line, sizeof(line),
+                     "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}",
+                     first ? "" : ",\n", ring->tid, ring->tid);
+            out << line;
+            first = false;
+            uint64_t written = ring->written.load(std::memory_order_acquire);
+            for (uint64_t i = written > ring_capacity ? written - ring_capacity : 0; i < written; ++i) {
+                const Event& event = ring->events[i % ring_capacity];
+                std::string detail = jsonEscape(event.detail);
+                snprintf(line, sizeof(line),
+                         ",\n{\"name\": \"%s\", \"cat\": \"matcher\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                         "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"detail\": \"%s\"}}",
+                         event.name, ring->tid, event.begin_ns / 1000.0, (event.end_ns - event.begin_ns) / 1000.0,
+                         detail.c_str());
+                out << line;
+            }
+        }
+        out << "\n]}\n";
+    }
+
+private:
+    static const size_t ring_capacity = 1 << 14;
+    
+    struct ThreadRing {
+        uint32_t tid = 0;
+        std::vector<Event> events = std::vector<Event>(ring_capacity);
+        std::atomic<uint64_t> written{0};
+    };
+    
+    // Returns the thread's ring to the free list when the thread exits
+    struct RingLease {
+        ThreadRing* ring = nullptr;
+        ~RingLease() {
+            if (!ring) return;
+            TraceRecorder& recorder = instance();
+            std::lock_guard<std::mutex> lock(recorder.rings_mutex);
+            recorder.free_rings.push_back(ring);
+        }
+    };
+    
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::vector<ThreadRing*> free_rings;
+    
+    ThreadRing& localRing() {
+        thread_local RingLease lease;
+        if (!lease.ring) {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            if (!free_rings.empty()) {
+                lease.ring = free_rings.back();
+                free_rings.pop_back();
+            } else {
+                rings.push_back(std::make_unique<ThreadRing>());
+                lease.ring = rings.back().get();
+                lease.ring->tid = static_cast<uint32_t>(rings.size());
+            }
+        }
+        return *lease.ring;
+    }
+};
+
+// Records one event covering the enclosing scope
+class TraceScope {
+public:
+    TraceScope(const char* name, std::string detail)
+        : name(name), detail(std::move(detail)) {
+        TraceRecorder::instance().attachThread();
+        begin_ns = TraceRecorder::instance().now();
+    }
+    ~TraceScope() { TraceRecorder::instance().record(name, begin_ns, detail); }
+
+private:
+    const char* name;
+    std::string detail;
+    uint64_t begin_ns;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name, detail) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name, detail)
+
+inline bool traceEnabled() { return true; }
+inline void traceReset() { TraceRecorder::instance().clear(); }
+inline void traceWrite(const std::string& path) { TraceRecorder::instance().write(path); }
+#else
+#define TRACE_SCOPE(name, detail) do {} while (0)
+
+inline bool traceEnabled() { return false; }
+inline void traceReset() {}
+inline void traceWrite(const std::string&) {
+    throw std::runtime_error("Tracing is not compiled in; rebuild with -DMATCHER_TRACE");
+}
+#endif
+
+// Reads a CSV file line by line like std::getline. Compressed files, gzip
+// (.csv.gz) or zlib (.csv.zz), are inflated a chunk at a time, so neither the
+// compressed nor the inflated file is ever held whole. They are only read by
+// builds with -DMATCHER_WITH_ZLIB (and -lz); other builds don't list them.
+class CSVLineReader {
+public:
+#ifdef MATCHER_WITH_ZLIB
+    static constexpr bool compression_supported = true;
+#else
+    static constexpr bool compression_supported = false;
+#endif
+    
+    static bool isCompressed(const std::string& filename) {
+        std::string ext = std::filesystem::path(filename).extension().string();
+        return ext == ".gz" || ext == ".zz";
+    }
+    
+    explicit CSVLineReader(const std::string& filename)
+        : path(filename), file(filename, isCompressed(filename) ? std::ios::binary : std::ios::in),
+          compressed(isCompressed(filename)) {
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open file: " + filename);
+        }
+        if (compressed) {
+#ifdef MATCHER_WITH_ZLIB
+            // windowBits 15 + 32: detect a gzip or zlib header
+            if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+                throw std::runtime_error("Cannot inflate file: " + filename);
+            }
+            input.resize(chunk_size);
+#else
+            throw std::runtime_error("Compressed input needs a build with -DMATCHER_WITH_ZLIB: " + filename);
+#endif
+        }
+    }
+    
+    ~CSVLineReader() {
+#ifdef MATCHER_WITH_ZLIB
+        if (compressed) inflateEnd(&stream);
+#endif
+    }
+    
+    CSVLineReader(const CSVLineReader&) = delete;
+    CSVLineReader& operator=(const CSVLineReader&) = delete;
+    
+    bool next(std::string& line) {
+        if (!compressed) return static_cast<bool>(std::getline(file, line));
+#ifdef MATCHER_WITH_ZLIB
+        while (true) {
+            size_t newline = pending.find('\n', pending_pos);
+            if (newline != std::string::npos) {
+                line.assign(pending, pending_pos, newline - pending_pos);
+                pending_pos = newline + 1;
+#ifdef _WIN32
+                // Like the text-mode stream that reads an uncompressed file
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+#endif
+                return true;
+            }
+            if (finished) {
+                if (pending_pos >= pending.size()) return false;
+                line.assign(pending, pending_pos, std::string::npos);
+                pending_pos = pending.size();
+                return true;
+            }
+            pending.erase(0, pending_pos);
+            pending_pos = 0;
+            inflateChunk();
+        }
+#else
+        return false;
+#endif
+    }
+
+private:
+    std::string path;
+    std::ifstream file;
+    bool compressed;
+#ifdef MATCHER_WITH_ZLIB
+    static constexpr size_t chunk_size = 256 * 1024;
+    
+    z_stream stream{};
+    std::vector<char> input;
+    std::string pending;        // Inflated text not yet returned
+    size_t pending_pos = 0;
+    bool finished = false;
+    bool member_done = false;   // The last inflate ended a gzip member or zlib stream
+    
+    // Appends up to chunk_size inflated bytes to pending. Concatenated gzip
+    // members, as written by parallel compressors, are read one after another.
+    void inflateChunk() {
+        if (stream.avail_in == 0) {
+            file.read(input.data(), static_cast<std::streamsize>(input.size()));
+            stream.next_in = reinterpret_cast<Bytef*>(input.data());
+            stream.avail_in = static_cast<uInt>(file.gcount());
+            if (stream.avail_in == 0) {
+                if (!member_done) {
+                    throw std::runtime_error("Truncated compressed file: " + path);
+                }
+                finished = true;
+                return;
+            }
+        }
+        if (member_done) {
+            inflateReset(&stream);
+            member_done = false;
+        }
+        size_t old_size = pending.size();
+        pending.resize(old_size + chunk_size);
+        stream.next_out = reinterpret_cast<Bytef*>(&pending[old_size]);
+        stream.avail_out = static_cast<uInt>(chunk_size);
+        int status = inflate(&stream, Z_NO_FLUSH);
+        pending.resize(old_size + chunk_size - stream.avail_out);
+        if (status == Z_STREAM_END) {
+            member_done = true;
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            throw std::runtime_error("Corrupt compressed file: " + path);
+        }
+    }
+#endif
+};
+
+class CSVReader {
+public:
+    // A CSV read throws once stop is cancelled, so background reads can be abandoned
+    static DataFrame readCSV(const std::string& filename, const CancellationToken* stop = nullptr) {
+        TRACE_SCOPE("read", std::filesystem::path(filename).filename().string());
+        if (isCSV(filename)) {
+            return readCSVFile(filename, stop);
+        } else if (endsWith(filename, ".xlsx")) {
+            return readXLSXFile(filename);
+        } else {
+            throw std::runtime_error("Unsupported file type: " + filename);
+        }
+    }
+    
+    static void writeCSV(const DataFrame& data, const std::string& filename) {
+        TRACE_SCOPE("write", std::filesystem::path(filename).filename().string());
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot create file: " + filename);
+        }
+        
+        std::string line;
+        for (const auto& row : data) {
+            line.clear();
+            appendCSVRow(line, row);
+            line += '\n';
+            file << line;
+        }
+    }
+    
+    static Row parseCSVLine(const std::string& line) {
+        Row row;
+        std::stringstream ss(line);
+        std::string cell;
+        
+        while (std::getline(ss, cell, ',')) {
+            // Remove quotes and trim whitespace
+            cell.erase(std::remove(cell.begin(), cell.end(), '"'), cell.end());
+            cell.erase(0, cell.find_first_not_of(" \t"));
+            cell.erase(cell.find_last_not_of(" \t") + 1);
+            row.push_back(cell);
+        }
+        return row;
+    }
+    
+    // Appends one row in the writeCSV format (every cell quoted), no newline
+    static void appendCSVRow(std::string& out, const Row& row) {
+        for (size_t i = 0; i < row.size(); ++i) {
+            if (i > 0) out += ',';
+            out += '"';
+            out += row[i];
+            out += '"';
+        }
+    }
+
+    // Plain or, in builds that read them, compressed (CSVLineReader) CSV
+    static bool isCSV(const std::string& filename) {
+        return endsWith(filename, ".csv") ||
+               (CSVLineReader::compression_supported && (endsWith(filename, ".csv.gz") || endsWith(filename, ".csv.zz")));
+    }
+    
+    // CSV already in memory, parsed exactly like a .csv file
+    static DataFrame readCSVText(std::string_view text) {
+        std::istringstream in{std::string(text)};
+        return readCSVStream(in);
+    }
+
+private:
+    static bool endsWith(const std::string& str, const std::string& suffix) {
+        return str.size() >= suffix.size() &&
+               str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    static DataFrame readCSVFile(const std::string& filename, const CancellationToken* stop = nullptr) {
+        CSVLineReader reader(filename);
+        DataFrame data;
+        std::string line;
+        while (reader.next(line)) {
+            if (stop && data.size() % 1024 == 0 && stop->isCancelled()) {
+                throw std::runtime_error("Read cancelled: " + filename);
+            }
+            Row row = parseCSVLine(line);
+            if (!row.empty()) {
+                data.push_back(row);
+            }
+        }
+        return data;
+    }
+    
+    static DataFrame readCSVStream(std::istream& in) {
+        DataFrame data;
+        std::string line;
+        while (std::getline(in, line)) {
+            Row row = parseCSVLine(line);
+            if (!row.empty()) {
+                data.push_back(row);
+            }
+        }
+        return data;
+    }
+
+    static DataFrame readXLSXFile(const std::string& filename) {
+        DataFrame data;
+        xlnt::workbook wb;
+        wb.load(filename);
+        auto ws = wb.active_sheet();
+        for (auto row : ws.rows(false)) {
+            Row row_data;
+            for (auto cell : row) {
+                row_data.push_back(cell.to_string());
+            }
+            data.push_back(row_data);
+        }
+        return data;
+    }
+};
+
+// Interns strings so the match kernel compares integers instead of text
+class StringDictionary {
+public:
+    int32_t intern(const std::string& text) {
+        auto it = ids.find(text);
+        if (it != ids.end()) return it->second;
+        int32_t id = static_cast<int32_t>(names.size());
+        ids.emplace(text, id);
+        names.push_back(text);
+        return id;
+    }
+    
+    int32_t find(const std::string& text) const {
+        auto it = ids.find(text);
+        return it == ids.end() ? -1 : it->second;
+    }
+    
+    const std::string& name(int32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+    
+    // Approximate bytes held, counting one hash node per entry
+    size_t footprint() const {
+        size_t bytes = ids.bucket_count() * sizeof(void*) + names.capacity() * sizeof(std::string);
+        for (const std::string& name : names) {
+            bytes += 2 * heapBytes(name) + sizeof(std::string) + sizeof(int32_t) + 2 * sizeof(void*);
+        }
+        return bytes;
+    }
+
+private:
+    std::unordered_map<std::string, int32_t> ids;
+    std::vector<std::string> names;
+};
+
+enum PredicateKind : uint8_t {
+    PRED_EQUAL,     // sign column: daily value must equal the pattern value
+    PRED_DEGREE,    // degree column: daily degree must fall in [a, b]
+    PRED_NEVER      // degree column whose pattern value is not a "low-high" range
+};
+
+struct Predicate {
+    uint8_t col;    // Index into daily_cols
+    uint8_t kind;
+    int32_t a;      // Value id for PRED_EQUAL, low bound for PRED_DEGREE
+    int32_t b;      // High bound for PRED_DEGREE
+};
+
+// Little helpers for the binary side files (native endianness)
+template <typename T>
+void writePod(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readPod(std::istream& in) {
+    T value{};
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+        throw std::runtime_error("Unexpected end of file");
+    }
+    return value;
+}
+
+inline void writeString(std::ostream& out, const std::string& text) {
+    writePod<uint32_t>(out, static_cast<uint32_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+inline std::string readString(std::istream& in) {
+    std::string text(readPod<uint32_t>(in), '\0');
+    if (!in.read(text.data(), text.size())) {
+        throw std::runtime_error("Unexpected end of file");
+    }
+    return text;
+}
+
+// 64-bit FNV-1a; stable across runs, so hashes can be persisted
+inline uint64_t hashText(std::string_view text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline uint64_t mixHash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Key of "daily column col holds the value hashed to value_hash"
+inline uint64_t zoneKey(size_t col, uint64_t value_hash) {
+    return mixHash(value_hash + (col + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Fixed-size Bloom filter over 64-bit keys, ~10 bits per key (~1% false positives)
+class BloomFilter {
+public:
+    BloomFilter() = default;
+    
+    explicit BloomFilter(size_t key_count) {
+        size_t bits = 64;
+        while (bits < key_count * 10) bits *= 2;
+        words.assign(bits / 64, 0);
+    }
+    
+    void add(uint64_t key) {
+        uint64_t h2 = mixHash(key) | 1;
+        for (int i = 0; i < probes; ++i, key += h2) {
+            uint64_t bit = key & (words.size() * 64 - 1);
+            words[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+    
+    bool mayContain(uint64_t key) const {
+        if (words.empty()) return false;
+        uint64_t h2 = mixHash(key) | 1;
+        for (int i = 0; i < probes; ++i, key += h2) {
+            uint64_t bit = key & (words.size() * 64 - 1);
+            if (!(words[bit / 64] & (1ULL << (bit % 64)))) return false;
+        }
+        return true;
+    }
+    
+    size_t footprint() const { return words.capacity() * sizeof(uint64_t); }
+    
+    void write(std::ostream& out) const {
+        writePod<uint32_t>(out, static_cast<uint32_t>(words.size()));
+        out.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+    }
+    
+    static BloomFilter read(std::istream& in) {
+        BloomFilter filter;
+        filter.words.resize(readPod<uint32_t>(in));
+        if (filter.words.size() & (filter.words.size() - 1)) {
+            throw std::runtime_error("Corrupt Bloom filter");
+        }
+        if (!in.read(reinterpret_cast<char*>(filter.words.data()), filter.words.size() * sizeof(uint64_t))) {
+            throw std::runtime_error("Unexpected end of file");
+        }
+        return filter;
+    }
+
+private:
+    static constexpr int probes = 6;
+    std::vector<uint64_t> words;    // Power-of-two count
+};
+
+// One daily row as the zone maps see it: hashed values and degrees per column
+struct ZoneRow {
+    std::array<uint64_t, 22> keys{};    // zoneKey of each present cell
+    std::array<int32_t, 22> degrees{};
+    uint32_t present = 0;               // Bit per column
+    uint32_t degree_valid = 0;
+};
+
+// The day's transit vector: every daily row keyed by the hash of its player
+class ZoneProbe {
+public:
+    void add(uint64_t player_hash, const ZoneRow& row) { rows[player_hash].push_back(row); }
+    
+    const std::vector<ZoneRow>* rowsFor(uint64_t player_hash) const {
+        auto it = rows.find(player_hash);
+        return it == rows.end() ? nullptr : &it->second;
+    }
+
+private:
+    std::unordered_map<uint64_t, std::vector<ZoneRow>> rows;
+};
+
+// Summary of a run of patterns that can prove none of them matches a day:
+// the players they belong to, the columns every one of them constrains, and
+// for those the values (Bloom filter) or degree span they can accept. Player
+// and value names are hashed, so a zone map outlives the run's dictionaries
+// and holds for folders mixing players whatever the file names say.
+struct ZoneMap {
+    uint32_t pattern_count = 0;
+    uint32_t required = 0;                  // Bit per column every pattern constrains
+    std::vector<uint64_t> players;          // Sorted player name hashes
+    std::array<int32_t, 22> degree_low{};   // Span of the degree ranges per column
+    std::array<int32_t, 22> degree_high{};  // (low > high: no range accepts anything)
+    BloomFilter values;                     // zoneKey of every equality predicate
+    
+    // False only if no daily row can satisfy any summarized pattern. A row
+    // must belong to one of the players and pass every required column;
+    // missing cells pass like they do in patternMatches.
+    bool mayMatch(const ZoneProbe& probe) const {
+        for (uint64_t player : players) {
+            const std::vector<ZoneRow>* rows = probe.rowsFor(player);
+            if (!rows) continue;
+            for (const ZoneRow& row : *rows) {
+                if (rowMayMatch(row)) return true;
+            }
+        }
+        return false;
+    }
+    
+    size_t footprint() const {
+        return players.capacity() * sizeof(uint64_t) + values.footprint();
+    }
+    
+    void write(std::ostream& out) const {
+        writePod<uint32_t>(out, pattern_count);
+        writePod<uint32_t>(out, required);
+        writePod<uint32_t>(out, static_cast<uint32_t>(players.size()));
+        for (uint64_t player : players) writePod<uint64_t>(out, player);
+        for (size_t c = 0; c < degree_low.size(); ++c) {
+            writePod<int32_t>(out, degree_low[c]);
+            writePod<int32_t>(out, degree_high[c]);
+        }
+        values.write(out);
+    }
+    
+    static ZoneMap read(std::istream& in) {
+        ZoneMap zone;
+        zone.pattern_count = readPod<uint32_t>(in);
+        zone.required = readPod<uint32_t>(in);
+        zone.players.resize(readPod<uint32_t>(in));
+        for (uint64_t& player : zone.players) player = readPod<uint64_t>(in);
+        for (size_t c = 0; c < zone.degree_low.size(); ++c) {
+            zone.degree_low[c] = readPod<int32_t>(in);
+            zone.degree_high[c] = readPod<int32_t>(in);
+        }
+        zone.values = BloomFilter::read(in);
+        return zone;
+    }
+
+private:
+    bool rowMayMatch(const ZoneRow& row) const {
+        uint32_t checked = required & row.present;
+        for (uint32_t c = 0; checked; ++c, checked >>= 1) {
+            if (!(checked & 1)) continue;
+            if (degree_low[c] <= degree_high[c]) {
+                if (!(row.degree_valid & (1u << c)) || row.degrees[c] < degree_low[c] ||
+                    row.degrees[c] > degree_high[c]) return false;
+            } else if (!values.mayContain(row.keys[c])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Accumulates patterns into a ZoneMap
+class ZoneBuilder {
+public:
+    ZoneBuilder() {
+        zone.required = (1u << zone.degree_low.size()) - 1;
+        zone.degree_low.fill(INT32_MAX);
+        zone.degree_high.fill(INT32_MIN);
+    }
+    
+    // value_keys[p] is the zoneKey of preds[p] when it is an equality predicate
+    void add(uint64_t player_hash, const Predicate* preds, uint32_t count, const uint64_t* value_keys) {
+        zone.pattern_count++;
+        if (players.empty() || players.back() != player_hash) players.push_back(player_hash);
+        uint32_t constrained = 0;
+        for (uint32_t p = 0; p < count; ++p) {
+            const Predicate& pred = preds[p];
+            constrained |= 1u << pred.col;
+            if (pred.kind == PRED_EQUAL) {
+                keys.push_back(value_keys[p]);
+            } else if (pred.kind == PRED_DEGREE) {
+                zone.degree_low[pred.col] = std::min(zone.degree_low[pred.col], pred.a);
+                zone.degree_high[pred.col] = std::max(zone.degree_high[pred.col], pred.b);
+            }
+        }
+        zone.required &= constrained;
+    }
+    
+    ZoneMap finish() {
+        if (zone.pattern_count == 0) zone.required = 0;
+        std::sort(players.begin(), players.end());
+        players.erase(std::unique(players.begin(), players.end()), players.end());
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        zone.players = std::move(players);
+        zone.values = BloomFilter(keys.size());
+        for (uint64_t key : keys) zone.values.add(key);
+        return std::move(zone);
+    }
+
+private:
+    ZoneMap zone;
+    std::vector<uint64_t> players;
+    std::vector<uint64_t> keys;
+};
+
+// One historical row after compilation
+struct CompiledPattern {
+    int32_t player;
+    uint32_t row;           // Row index in the historical file (patterns may be filtered out)
+    uint32_t pred_begin;    // Range in CompiledFile::predicates
+    uint32_t pred_count;
+    uint32_t text_begin;    // Range in CompiledFile::text
+    uint32_t text_length;
+};
+
+// A historical file compiled once and matched against any number of slates
+struct CompiledFile {
+    std::string path;
+    std::string name;
+    uint64_t bytes = 0;
+    std::vector<CompiledPattern> patterns;
+    std::vector<Predicate> predicates;
+    std::string text;       // Raw rows pre-rendered in the output CSV format
+    ZoneMap zone;                   // All patterns
+    std::vector<ZoneMap> blocks;    // Every zone_block consecutive patterns
+    uint64_t rows_dropped = 0;      // Rows the pattern filter left out
+    
+    static constexpr uint32_t zone_block = 1024;
+    
+    std::string_view rowText(const CompiledPattern& pattern) const {
+        return std::string_view(text).substr(pattern.text_begin, pattern.text_length);
+    }
+    
+    size_t footprint() const {
+        size_t bytes = patterns.capacity() * sizeof(CompiledPattern) + predicates.capacity() * sizeof(Predicate) +
+                       text.capacity() + zone.footprint() + blocks.capacity() * sizeof(ZoneMap);
+        for (const ZoneMap& block : blocks) bytes += block.footprint();
+        return bytes;
+    }
+};
+
+struct DailyCell {
+    int32_t value = -1;         // Value id; -1 if the corpus never uses it
+    int32_t degree = 0;
+    bool present = false;       // False for missing or empty cells, which match anything
+    bool degree_valid = false;
+};
+
+// One daily file projected onto the transit columns and keyed by player
+struct DailySlate {
+    std::string daily_file;
+    std::vector<std::string> rendered;                  // Raw rows in the output CSV format
+    std::vector<std::array<DailyCell, 22>> cells;       // Indexed like daily_cols
+    std::vector<std::vector<uint32_t>> rows_by_player;  // Player id -> daily row indices
+    std::vector<uint64_t> fingerprints;                 // Player id -> hash of the player's filtered rows
+    
+    const std::vector<uint32_t>* rowsFor(int32_t player) const {
+        if (player < 0 || static_cast<size_t>(player) >= rows_by_player.size()) return nullptr;
+        const auto& rows = rows_by_player[player];
+        return rows.empty() ? nullptr : &rows;
+    }
+    
+    size_t footprint() const {
+        size_t bytes = rendered.capacity() * sizeof(std::string) + cells.capacity() * sizeof(cells[0]) +
+                       rows_by_player.capacity() * sizeof(rows_by_player[0]);
+        for (const std::string& row : rendered) bytes += heapBytes(row);
+        for (const auto& rows : rows_by_player) bytes += rows.capacity() * sizeof(uint32_t);
+        return bytes;
+    }
+};
+
+// A match as (pattern index in its file, daily row index)
+struct MatchRef {
+    uint32_t pattern;
+    uint32_t daily;
+};
+
+// How often each predicate lets a daily row through, estimated from the daily
+// cells seen so far (per column, per value id and per degree). A pattern is
+// rejected by its first failing predicate, so ordering predicates by pass
+// rate, lowest first, minimizes the checks spent on rejected patterns. Map
+// key order would instead check AP first whatever its selectivity.
+class SelectivityStats {
+public:
+    void observe(const DailySlate& slate) {
+        for (const auto& cells : slate.cells) {
+            rows++;
+            for (size_t c = 0; c < cells.size(); ++c) {
+                const DailyCell& cell = cells[c];
+                if (!cell.present) continue;
+                Column& column = columns[c];
+                column.present++;
+                if (cell.value >= 0) {
+                    if (static_cast<size_t>(cell.value) >= column.values.size()) column.values.resize(cell.value + 1);
+                    column.values[cell.value]++;
+                }
+                if (cell.degree_valid && cell.degree >= 0 && cell.degree < tracked_degrees) {
+                    if (column.degrees.empty()) column.degrees.assign(tracked_degrees, 0);
+                    column.degrees[cell.degree]++;
+                }
+            }
+        }
+        for (Column& column : columns) {
+            if (column.degrees.empty()) continue;
+            column.degrees_below.assign(tracked_degrees + 1, 0);
+            for (int32_t d = 0; d < tracked_degrees; ++d) {
+                column.degrees_below[d + 1] = column.degrees_below[d] + column.degrees[d];
+            }
+        }
+    }
+    
+    uint64_t rowsObserved() const { return rows; }
+    
+    // Laplace-smoothed share of daily rows the predicate accepts. Missing
+    // cells match anything, so they count as passes.
+    double passRate(const Predicate& pred) const {
+        const Column& column = columns[pred.col];
+        uint64_t passed = rows - column.present;
+        switch (pred.kind) {
+            case PRED_EQUAL:
+                if (pred.a >= 0 && static_cast<size_t>(pred.a) < column.values.size()) passed += column.values[pred.a];
+                break;
+            case PRED_DEGREE:
+                if (!column.degrees_below.empty() && pred.a <= pred.b && pred.b >= 0 && pred.a < tracked_degrees) {
+                    int32_t low = std::max(pred.a, 0);
+                    int32_t high = std::min(pred.b, tracked_degrees - 1);
+                    passed += column.degrees_below[high + 1] - column.degrees_below[low];
+                }
+                break;
+            default:
+                break;
+        }
+        return (passed + 1.0) / (rows + 2.0);
+    }
+    
+    // Most selective first; ties keep column order so the result is stable
+    void orderPredicates(Predicate* preds, uint32_t count) const {
+        if (rows == 0 || count < 2) return;
+        std::array<std::pair<double, Predicate>, 22> keyed;
+        count = std::min<uint32_t>(count, static_cast<uint32_t>(keyed.size()));
+        for (uint32_t p = 0; p < count; ++p) keyed[p] = {passRate(preds[p]), preds[p]};
+        std::stable_sort(keyed.begin(), keyed.begin() + count,
+            [](const auto& x, const auto& y) { return x.first < y.first; });
+        for (uint32_t p = 0; p < count; ++p) preds[p] = keyed[p].second;
+    }
+    
+    void orderFile(CompiledFile& file) const {
+        for (const CompiledPattern& pattern : file.patterns) {
+            orderPredicates(file.predicates.data() + pattern.pred_begin, pattern.pred_count);
+        }
+    }
+
+private:
+    // Degree buckets are 0-29 in practice; anything past this is untracked
+    static constexpr int32_t tracked_degrees = 1024;
+    
+    struct Column {
+        uint64_t present = 0;
+        std::vector<uint64_t> values;           // Value id -> daily cells holding it
+        std::vector<uint64_t> degrees;          // Degree -> daily cells holding it
+        std::vector<uint64_t> degrees_below;    // [d] = cells with a degree below d
+    };
+    
+    uint64_t rows = 0;
+    std::array<Column, 22> columns;
+};
+
+// Writes next to the destination and renames, so watchers never see a partial file
+inline void writeFileAtomically(const std::string& path, const std::string& content) {
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        if (!out.is_open()) {
+            throw std::runtime_error("Cannot create file: " + path);
+        }
+        out << content;
+        if (!out) {
+            throw std::runtime_error("Cannot write file: " + path);
+        }
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+// Where the engine keeps what it learns about a historical folder (zone maps,
+// cached results): <cache_root>/<folder name>-<hash of its absolute path>,
+// never the input folder itself. An empty cache_root is the per-user cache,
+// %LOCALAPPDATA%\matcher or $XDG_CACHE_HOME/matcher (~/.cache/matcher).
+// Empty when there is no such directory.
+inline std::string cacheDirectoryFor(const std::string& historical_folder, const std::string& cache_root = "") {
+    std::filesystem::path root = cache_root;
+    if (root.empty()) {
+#ifdef _WIN32
+        const char* local_app_data = std::getenv("LOCALAPPDATA");
+        if (local_app_data && *local_app_data) root = std::filesystem::path(local_app_data) / "matcher";
+#else
+        const char* xdg_cache = std::getenv("XDG_CACHE_HOME");
+        const char* home = std::getenv("HOME");
+        if (xdg_cache && *xdg_cache) {
+            root = std::filesystem::path(xdg_cache) / "matcher";
+        } else if (home && *home) {
+            root = std::filesystem::path(home) / ".cache" / "matcher";
+        }
+#endif
+    }
+    if (root.empty()) return "";
+    std::error_code error;
+    std::filesystem::path folder = std::filesystem::weakly_canonical(std::filesystem::absolute(historical_folder), error);
+    if (error) folder = std::filesystem::absolute(historical_folder).lexically_normal();
+    if (!folder.has_filename()) folder = folder.parent_path();
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(hashText(folder.generic_string())));
+    return (root / (folder.filename().string() + "-" + hash)).string();
+}
+
+// File-level zone maps of a historical folder, kept in its cache directory so
+// later runs can rule files out before reading them. An entry is only trusted
+// while its file's size and modification time are unchanged, and by runs
+// filtering patterns the same way (a filtered zone map summarizes fewer rows).
+class ZoneIndex {
+public:
+    // Empty when there is no cache directory; the index then lives for one run
+    static std::string pathFor(const std::string& historical_folder, const std::string& cache_root = "") {
+        std::string directory = cacheDirectoryFor(historical_folder, cache_root);
+        return directory.empty() ? "" : (std::filesystem::path(directory) / "zones.bin").string();
+    }
+    
+    // A missing or unreadable index is just empty; it is rebuilt as files are compiled
+    static ZoneIndex load(const std::string& path) {
+        ZoneIndex index;
+        if (path.empty()) return index;
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return index;
+        try {
+            char header[sizeof(magic)];
+            if (!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0) return index;
+            uint32_t count = readPod<uint32_t>(in);
+            for (uint32_t i = 0; i < count; ++i) {
+                std::string name = readString(in);
+                Entry entry;
+                entry.size = readPod<uint64_t>(in);
+                entry.mtime = readPod<int64_t>(in);
+                entry.filter = readPod<uint64_t>(in);
+                entry.zone = ZoneMap::read(in);
+                index.entries.emplace(std::move(name), std::move(entry));
+            }
+        } catch (const std::exception&) {
+            index.entries.clear();
+        }
+        return index;
+    }
+    
+    static int64_t modificationTime(const std::string& path) {
+        return static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+    }
+    
+    const ZoneMap* find(const std::string& name, uint64_t size, int64_t mtime, uint64_t filter) const {
+        auto it = entries.find(name);
+        if (it == entries.end() || it->second.size != size || it->second.mtime != mtime || it->second.filter != filter) {
+            return nullptr;
+        }
+        return &it->second.zone;
+    }
+    
+    void put(const std::string& name, uint64_t size, int64_t mtime, uint64_t filter, const ZoneMap& zone) {
+        entries[name] = {size, mtime, filter, zone};
+        changed = true;
+    }
+    
+    // Drops entries of files no longer in the folder
+    void retain(const std::vector<std::string>& paths) {
+        std::set<std::string> names;
+        for (const std::string& path : paths) names.insert(std::filesystem::path(path).filename().string());
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (names.count(it->first)) {
+                ++it;
+            } else {
+                it = entries.erase(it);
+                changed = true;
+            }
+        }
+    }
+    
+    bool isChanged() const { return changed; }
+    
+    void save(const std::string& path) const {
+        std::ostringstream out(std::ios::binary);
+        out.write(magic, sizeof(magic));
+        writePod<uint32_t>(out, static_cast<uint32_t>(entries.size()));
+        for (const auto& [name, entry] : entries) {
+            writeString(out, name);
+            writePod<uint64_t>(out, entry.size);
+            writePod<int64_t>(out, entry.mtime);
+            writePod<uint64_t>(out, entry.filter);
+            entry.zone.write(out);
+        }
+        if (path.empty()) return;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::binary);
+            if (!file.is_open() || !(file << out.str())) {
+                throw std::runtime_error("Cannot write file: " + path);
+            }
+        }
+        std::filesystem::rename(tmp_path, path);
+    }
+
+private:
+    struct Entry {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t filter = 0;    // PatternFilter::signature
+        ZoneMap zone;
+    };
+    
+    static constexpr char magic[8] = {'M', 'Z', 'O', 'N', 'E', 'S', '0', '2'};
+    std::map<std::string, Entry> entries;
+    bool changed = false;
+};
+
+// Normalized form of a _Matches.csv. A wide row repeats the whole daily row
+// for every pattern it matched; these tables hold each daily row and each
+// matched pattern once and the matches as ids. Written to <daily>_Matches/:
+//   daily.csv     daily_id,<daily row>
+//   files.csv     file_id,<historical file name>
+//   patterns.csv  file_id,pattern_row,<historical row>
+//   matches.csv   daily_id,file_id,pattern_row     (in _Matches.csv order)
+// Rows keep the _Matches.csv cell format, so expand() rebuilds it byte for byte.
+class NormalizedOutput {
+public:
+    static std::string directoryFor(const std::string& daily_file) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_Matches";
+    }
+    
+    // Writes into <directory>.tmp until publish
+    NormalizedOutput(const std::string& output_directory, size_t daily_rows)
+        : directory(output_directory), tmp_directory(output_directory + ".tmp"), daily_used(daily_rows, 0) {
+        std::filesystem::remove_all(tmp_directory);
+        std::filesystem::create_directories(tmp_directory);
+        files.open(tmp_directory + "/files.csv");
+        patterns.open(tmp_directory + "/patterns.csv");
+        matches.open(tmp_directory + "/matches.csv");
+        if (!files.is_open() || !patterns.is_open() || !matches.is_open()) {
+            throw std::runtime_error("Cannot create files in: " + tmp_directory);
+        }
+    }
+    
+    // refs are one file's matches for the slate, in pattern order
+    void add(uint32_t file_id, const CompiledFile& file, const std::vector<MatchRef>& refs) {
+        if (refs.empty()) return;
+        buffer.clear();
+        buffer += std::to_string(file_id);
+        buffer += ',';
+        CSVReader::appendCSVRow(buffer, {file.name});
+        buffer += '\n';
+        files << buffer;
+        
+        std::string pattern_rows;
+        buffer.clear();
+        uint32_t last_pattern = UINT32_MAX;
+        for (const MatchRef& ref : refs) {
+            uint32_t row = file.patterns[ref.pattern].row;
+            if (ref.pattern != last_pattern) {
+                last_pattern = ref.pattern;
+                pattern_rows += std::to_string(file_id);
+                pattern_rows += ',';
+                pattern_rows += std::to_string(row);
+                pattern_rows += ',';
+                pattern_rows += file.rowText(file.patterns[ref.pattern]);
+                pattern_rows += '\n';
+            }
+            buffer += std::to_string(ref.daily);
+            buffer += ',';
+            buffer += std::to_string(file_id);
+            buffer += ',';
+            buffer += std::to_string(row);
+            buffer += '\n';
+            daily_used[ref.daily] = 1;
+        }
+        patterns << pattern_rows;
+        matches << buffer;
+    }
+    
+    // Writes the daily rows that matched and replaces any previous output
+    void publish(const DailySlate& slate) {
+        std::ofstream daily(tmp_directory + "/daily.csv");
+        for (size_t i = 0; i < daily_used.size(); ++i) {
+            if (daily_used[i]) daily << i << ',' << slate.rendered[i] << '\n';
+        }
+        daily.close();
+        files.close();
+        patterns.close();
+        matches.close();
+        if (!daily || !files || !patterns || !matches) {
+            throw std::runtime_error("Cannot write files in: " + tmp_directory);
+        }
+        std::filesystem::remove_all(directory);
+        std::filesystem::rename(tmp_directory, directory);
+    }
+    
+    void discard() {
+        files.close();
+        patterns.close();
+        matches.close();
+        std::filesystem::remove_all(tmp_directory);
+    }
+    
+    // Rebuilds the wide _Matches.csv layout from a normalized directory
+    static size_t expand(const std::string& directory, const std::string& output_path) {
+        auto open = [&directory](const char* name) {
+            std::ifstream in(directory + "/" + name);
+            if (!in.is_open()) {
+                throw std::runtime_error("Cannot open file: " + directory + "/" + name);
+            }
+            return in;
+        };
+        // "<id>,<rest>": the ids are plain numbers, the rest is kept verbatim
+        auto splitId = [&directory](const std::string& line, size_t& pos) {
+            size_t comma = line.find(',', pos);
+            if (comma == std::string::npos || comma == pos) {
+                throw std::runtime_error("Corrupt normalized output in " + directory + ": " + line);
+            }
+            uint64_t id = std::stoull(line.substr(pos, comma - pos));
+            pos = comma + 1;
+            return id;
+        };
+        
+        std::unordered_map<uint64_t, std::string> daily_rows;
+        std::unordered_map<uint64_t, std::string> pattern_rows;
+        std::string line;
+        std::ifstream daily = open("daily.csv");
+        while (std::getline(daily, line)) {
+            size_t pos = 0;
+            uint64_t id = splitId(line, pos);
+            daily_rows[id] = line.substr(pos);
+        }
+        std::ifstream patterns = open("patterns.csv");
+        while (std::getline(patterns, line)) {
+            size_t pos = 0;
+            uint64_t file_id = splitId(line, pos);
+            uint64_t row = splitId(line, pos);
+            pattern_rows[file_id << 32 | row] = line.substr(pos);
+        }
+        
+        std::ifstream matches = open("matches.csv");
+        std::ofstream out(output_path + ".tmp");
+        if (!out.is_open()) {
+            throw std::runtime_error("Cannot create file: " + output_path);
+        }
+        std::string wide;
+        size_t count = 0;
+        while (std::getline(matches, line)) {
+            size_t pos = 0;
+            uint64_t daily_id = splitId(line, pos);
+            uint64_t file_id = splitId(line, pos);
+            uint64_t row = std::stoull(line.substr(pos));
+            auto daily_it = daily_rows.find(daily_id);
+            auto pattern_it = pattern_rows.find(file_id << 32 | row);
+            if (daily_it == daily_rows.end() || pattern_it == pattern_rows.end()) {
+                throw std::runtime_error("Corrupt normalized output in " + directory + ": unknown ids in " + line);
+            }
+            wide += daily_it->second;
+            wide += ',';
+            wide += pattern_it->second;
+            wide += '\n';
+            count++;
+            if (wide.size() > (1 << 20)) {
+                out << wide;
+                wide.clear();
+            }
+        }
+        out << wide;
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Cannot write file: " + output_path);
+        }
+        std::filesystem::rename(output_path + ".tmp", output_path);
+        return count;
+    }
+
+private:
+    std::string directory;
+    std::string tmp_directory;
+    std::ofstream files;
+    std::ofstream patterns;
+    std::ofstream matches;
+    std::vector<uint8_t> daily_used;    // Daily rows referenced by some match
+    std::string buffer;
+};
+
+// The distinct (player, historical file, pattern row) keys of one day's
+// matches. Saved as <daily>_MatchSet.bin, it lets the next day's run write
+// only the matches that were added or dropped (RunOptions::previous_match_set).
+// Players and files are stored once, in name order, and the keys as sorted
+// id triples, so a set is a few bytes per match.
+class MatchSet {
+public:
+    struct Key {
+        uint32_t player;
+        uint32_t file;
+        uint32_t row;
+        
+        bool operator<(const Key& other) const {
+            return std::tie(player, file, row) < std::tie(other.player, other.file, other.row);
+        }
+        bool operator==(const Key& other) const {
+            return player == other.player && file == other.file && row == other.row;
+        }
+    };
+    
+    static std::string pathFor(const std::string& daily_file) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_MatchSet.bin";
+    }
+    
+    void add(const std::string& player, const std::string& file, uint32_t row) {
+        keys.push_back({intern(players, player_ids, player), intern(files, file_ids, file), row});
+    }
+    
+    // Puts names and keys in order and drops duplicates; needed before contains()
+    void finish() {
+        std::vector<uint32_t> player_rank = renumber(players, player_ids);
+        std::vector<uint32_t> file_rank = renumber(files, file_ids);
+        for (Key& key : keys) {
+            key.player = player_rank[key.player];
+            key.file = file_rank[key.file];
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    }
+    
+    bool contains(const std::string& player, const std::string& file, uint32_t row) const {
+        auto player_it = player_ids.find(player);
+        auto file_it = file_ids.find(file);
+        if (player_it == player_ids.end() || file_it == file_ids.end()) return false;
+        return std::binary_search(keys.begin(), keys.end(), Key{player_it->second, file_it->second, row});
+    }
+    
+    const std::vector<Key>& entries() const { return keys; }
+    const std::string& player(const Key& key) const { return players[key.player]; }
+    const std::string& file(const Key& key) const { return files[key.file]; }
+    size_t size() const { return keys.size(); }
+    
+    void save(const std::string& path) const {
+        std::ostringstream out(std::ios::binary);
+        out.write(magic, sizeof(magic));
+        writePod<uint32_t>(out, static_cast<uint32_t>(players.size()));
+        for (const std::string& name : players) writeString(out, name);
+        writePod<uint32_t>(out, static_cast<uint32_t>(files.size()));
+        for (const std::string& name : files) writeString(out, name);
+        writePod<uint32_t>(out, static_cast<uint32_t>(keys.size()));
+        for (const Key& key : keys) {
+            writePod<uint32_t>(out, key.player);
+            writePod<uint32_t>(out, key.file);
+            writePod<uint32_t>(out, key.row);
+        }
+        writeFileAtomically(path, out.str());
+    }
+    
+    static MatchSet load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Cannot open file: " + path);
+        }
+        char header[sizeof(magic)];
+        if (!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Not a match set file: " + path);
+        }
+        MatchSet set;
+        set.players.resize(readPod<uint32_t>(in));
+        for (std::string& name : set.players) name = readString(in);
+        set.files.resize(readPod<uint32_t>(in));
+        for (std::string& name : set.files) name = readString(in);
+        set.keys.resize(readPod<uint32_t>(in));
+        for (Key& key : set.keys) {
+            key.player = readPod<uint32_t>(in);
+            key.file = readPod<uint32_t>(in);
+            key.row = readPod<uint32_t>(in);
+            if (key.player >= set.players.size() || key.file >= set.files.size()) {
+                throw std::runtime_error("Corrupt match set file: " + path);
+            }
+        }
+        for (uint32_t i = 0; i < set.players.size(); ++i) set.player_ids.emplace(set.players[i], i);
+        for (uint32_t i = 0; i < set.files.size(); ++i) set.file_ids.emplace(set.files[i], i);
+        return set;
+    }
+
+private:
+    static constexpr char magic[8] = {'M', 'M', 'A', 'T', 'S', 'E', 'T', '1'};
+    
+    std::vector<std::string> players;
+    std::vector<std::string> files;
+    std::unordered_map<std::string, uint32_t> player_ids;
+    std::unordered_map<std::string, uint32_t> file_ids;
+    std::vector<Key> keys;
+    
+    static uint32_t intern(std::vector<std::string>& names, std::unordered_map<std::string, uint32_t>& ids,
+                           const std::string& name) {
+        auto [it, inserted] = ids.emplace(name, static_cast<uint32_t>(names.size()));
+        if (inserted) names.push_back(name);
+        return it->second;
+    }
+    
+    // Sorts names and returns old id -> new id
+    static std::vector<uint32_t> renumber(std::vector<std::string>& names, std::unordered_map<std::string, uint32_t>& ids) {
+        std::vector<uint32_t> order(names.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&names](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+        std::vector<uint32_t> rank(names.size());
+        std::vector<std::string> sorted(names.size());
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            rank[order[i]] = i;
+            sorted[i] = std::move(names[order[i]]);
+        }
+        names = std::move(sorted);
+        for (auto& [name, id] : ids) id = rank[id];
+        return rank;
+    }
+};
+
+// Roaring-style compressed bitmap over 32-bit ids. Ids are grouped by their
+// high 16 bits; a group is a sorted array of low halves while sparse and a
+// 65536-bit bitset once it holds more than 4096 ids.
+class HitBitmap {
+public:
+    void add(uint32_t id) {
+        Container& container = containerFor(static_cast<uint16_t>(id >> 16));
+        uint16_t low = static_cast<uint16_t>(id & 0xFFFF);
+        if (!container.bits.empty()) {
+            container.bits[low >> 6] |= uint64_t(1) << (low & 63);
+            return;
+        }
+        auto it = std::lower_bound(container.array.begin(), container.array.end(), low);
+        if (it != container.array.end() && *it == low) return;
+        container.array.insert(it, low);
+        if (container.array.size() > array_limit) {
+            container.bits.assign(1024, 0);
+            for (uint16_t value : container.array) {
+                container.bits[value >> 6] |= uint64_t(1) << (value & 63);
+            }
+            container.array.clear();
+            container.array.shrink_to_fit();
+        }
+    }
+    
+    bool contains(uint32_t id) const {
+        const Container* container = findContainer(static_cast<uint16_t>(id >> 16));
+        if (!container) return false;
+        uint16_t low = static_cast<uint16_t>(id & 0xFFFF);
+        if (!container->bits.empty()) {
+            return (container->bits[low >> 6] >> (low & 63)) & 1;
+        }
+        return std::binary_search(container->array.begin(), container->array.end(), low);
+    }
+    
+    size_t cardinality() const {
+        size_t count = 0;
+        for (const Container& container : containers) {
+            if (container.bits.empty()) {
+                count += container.array.size();
+                continue;
+            }
+            for (uint64_t word : container.bits) {
+                count += static_cast<size_t>(__builtin_popcountll(word));
+            }
+        }
+        return count;
+    }
+    
+    // Visits ids in ascending order
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const Container& container : containers) {
+            uint32_t high = static_cast<uint32_t>(container.key) << 16;
+            if (container.bits.empty()) {
+                for (uint16_t low : container.array) fn(high | low);
+                continue;
+            }
+            for (uint32_t w = 0; w < container.bits.size(); ++w) {
+                uint64_t word = container.bits[w];
+                while (word) {
+                    fn(high | (w << 6) | static_cast<uint32_t>(__builtin_ctzll(word)));
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+    
+    void write(std::ostream& out) const {
+        writePod<uint32_t>(out, static_cast<uint32_t>(containers.size()));
+        for (const Container& container : containers) {
+            writePod<uint16_t>(out, container.key);
+            writePod<uint8_t>(out, container.bits.empty() ? 0 : 1);
+            if (container.bits.empty()) {
+                writePod<uint32_t>(out, static_cast<uint32_t>(container.array.size()));
+                out.write(reinterpret_cast<const char*>(container.array.data()), container.array.size() * sizeof(uint16_t));
+            } else {
+                out.write(reinterpret_cast<const char*>(container.bits.data()), container.bits.size() * sizeof(uint64_t));
+            }
+        }
+    }
+    
+    // Counts are checked before anything is allocated for them, so a corrupt
+    // file fails instead of allocating without bound or yielding bad ids
+    static HitBitmap read(std::istream& in) {
+        HitBitmap bitmap;
+        uint32_t container_count = readPod<uint32_t>(in);
+        if (container_count > 65536) throw std::runtime_error("Corrupt hit matrix: too many bitmap containers");
+        bitmap.containers.resize(container_count);
+        for (size_t c = 0; c < bitmap.containers.size(); ++c) {
+            Container& container = bitmap.containers[c];
+            container.key = readPod<uint16_t>(in);
+            if (c > 0 && container.key <= bitmap.containers[c - 1].key) {
+                throw std::runtime_error("Corrupt hit matrix: bitmap container keys out of order");
+            }
+            uint8_t dense = readPod<uint8_t>(in);
+            if (dense > 1) throw std::runtime_error("Corrupt hit matrix: unknown bitmap container type");
+            if (!dense) {
+                uint32_t size = readPod<uint32_t>(in);
+                if (size > array_limit) throw std::runtime_error("Corrupt hit matrix: bitmap array container too large");
+                container.array.resize(size);
+                in.read(reinterpret_cast<char*>(container.array.data()), container.array.size() * sizeof(uint16_t));
+                if (std::adjacent_find(container.array.begin(), container.array.end(), std::greater_equal<uint16_t>()) !=
+                    container.array.end()) {
+                    throw std::runtime_error("Corrupt hit matrix: bitmap array container out of order");
+                }
+            } else {
+                container.bits.resize(1024);
+                in.read(reinterpret_cast<char*>(container.bits.data()), container.bits.size() * sizeof(uint64_t));
+            }
+            if (!in) throw std::runtime_error("Truncated bitmap");
+        }
+        return bitmap;
+    }
+
+private:
+    static const size_t array_limit = 4096;
+    
+    struct Container {
+        uint16_t key = 0;
+        std::vector<uint16_t> array;    // Sorted low halves while sparse
+        std::vector<uint64_t> bits;     // 1024 words once dense
+    };
+    std::vector<Container> containers;  // Sorted by key
+    
+    Container& containerFor(uint16_t key) {
+        // Ids usually arrive in ascending order, so check the tail first
+        if (containers.empty() || containers.back().key < key) {
+            containers.push_back(Container());
+            containers.back().key = key;
+            return containers.back();
+        }
+        auto it = std::lower_bound(containers.begin(), containers.end(), key,
+            [](const Container& container, uint16_t k) { return container.key < k; });
+        if (it == containers.end() || it->key != key) {
+            it = containers.insert(it, Container());
+            it->key = key;
+        }
+        return *it;
+    }
+    
+    const Container* findContainer(uint16_t key) const {
+        auto it = std::lower_bound(containers.begin(), containers.end(), key,
+            [](const Container& container, uint16_t k) { return container.key < k; });
+        return it == containers.end() || it->key != key ? nullptr : &*it;
+    }
+};
+
+// Pattern x day hit matrix of a batch run. Pattern ids number the rows of the
+// historical files in visit order; each day keeps a bitmap of the ids that
+// matched at least one of its daily rows.
+class HitMatrix {
+public:
+    struct FileEntry {
+        std::string name;
+        uint32_t first_pattern = 0;
+        uint32_t pattern_count = 0;
+    };
+    
+    std::vector<std::string> days;              // Daily file stems
+    std::vector<FileEntry> files;
+    std::vector<std::string> players;
+    std::vector<int32_t> pattern_players;       // Pattern id -> index into players
+    std::vector<HitBitmap> hits;                // One bitmap per day
+    
+    size_t patternCount() const { return pattern_players.size(); }
+    
+    const FileEntry& fileOf(uint32_t pattern) const {
+        auto it = std::upper_bound(files.begin(), files.end(), pattern,
+            [](uint32_t id, const FileEntry& file) { return id < file.first_pattern; });
+        return *(it - 1);
+    }
+    
+    // Written whole to a temporary file and renamed, so a crash or a full
+    // disk never leaves a truncated matrix behind
+    void save(const std::string& path) const {
+        std::ostringstream out(std::ios::binary);
+        out.write(magic, sizeof(magic));
+        writePod<uint32_t>(out, static_cast<uint32_t>(days.size()));
+        for (const std::string& day : days) writeString(out, day);
+        writePod<uint32_t>(out, static_cast<uint32_t>(files.size()));
+        for (const FileEntry& file : files) {
+            writeString(out, file.name);
+            writePod<uint32_t>(out, file.first_pattern);
+            writePod<uint32_t>(out, file.pattern_count);
+        }
+        writePod<uint32_t>(out, static_cast<uint32_t>(players.size()));
+        for (const std::string& player : players) writeString(out, player);
+        
+        // Player ids come in long runs (one file per player), so run-length encode them
+        std::vector<std::pair<int32_t, uint32_t>> runs;
+        for (int32_t player : pattern_players) {
+            if (!runs.empty() && runs.back().first == player) {
+                runs.back().second++;
+            } else {
+                runs.emplace_back(player, 1);
+            }
+        }
+        writePod<uint32_t>(out, static_cast<uint32_t>(runs.size()));
+        for (const auto& [player, length] : runs) {
+            writePod<int32_t>(out, player);
+            writePod<uint32_t>(out, length);
+        }
+        for (const HitBitmap& bitmap : hits) bitmap.write(out);
+        writeFileAtomically(path, out.str());
+    }
+    
+    static HitMatrix load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Cannot open file: " + path);
+        }
+        char header[sizeof(magic)];
+        if (!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Not a hit matrix file: " + path);
+        }
+        // Lists grow as their entries are read, so a bad count ends at the end of the file
+        HitMatrix matrix;
+        for (uint32_t d = readPod<uint32_t>(in); d > 0; --d) matrix.days.push_back(readString(in));
+        uint64_t pattern_total = 0;
+        for (uint32_t f = readPod<uint32_t>(in); f > 0; --f) {
+            FileEntry file;
+            file.name = readString(in);
+            file.first_pattern = readPod<uint32_t>(in);
+            file.pattern_count = readPod<uint32_t>(in);
+            if (file.first_pattern != pattern_total) throw std::runtime_error("Corrupt hit matrix: file pattern ranges don't line up");
+            pattern_total += file.pattern_count;
+            matrix.files.push_back(std::move(file));
+        }
+        for (uint32_t p = readPod<uint32_t>(in); p > 0; --p) matrix.players.push_back(readString(in));
+        uint32_t run_count = readPod<uint32_t>(in);
+        for (uint32_t r = 0; r < run_count; ++r) {
+            int32_t player = readPod<int32_t>(in);
+            uint32_t length = readPod<uint32_t>(in);
+            if (player < 0 || static_cast<size_t>(player) >= matrix.players.size() ||
+                length > pattern_total - matrix.pattern_players.size()) {
+                throw std::runtime_error("Corrupt hit matrix: bad pattern player run");
+            }
+            matrix.pattern_players.insert(matrix.pattern_players.end(), length, player);
+        }
+        if (matrix.pattern_players.size() != pattern_total) throw std::runtime_error("Corrupt hit matrix: pattern count mismatch");
+        for (size_t d = 0; d < matrix.days.size(); ++d) {
+            matrix.hits.push_back(HitBitmap::read(in));
+            bool in_range = true;
+            matrix.hits.back().forEach([&](uint32_t id) { in_range = in_range && id < pattern_total; });
+            if (!in_range) throw std::runtime_error("Corrupt hit matrix: hit beyond the last pattern");
+        }
+        return matrix;
+    }
+
+private:
+    static constexpr char magic[8] = {'M', 'H', 'I', 'T', 'M', 'A', 'T', '1'};
+};
+
+// HDR-style latency histogram: values are bucketed by power of two and each
+// power of two is split into 16 linear sub-buckets (~6% relative error).
+// Recording is a couple of relaxed atomic operations, so any thread may record.
+class LatencyHistogram {
+public:
+    void record(uint64_t value) {
+        counts[indexOf(value)].fetch_add(1, std::memory_order_relaxed);
+        total_count.fetch_add(1, std::memory_order_relaxed);
+        total_sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t seen = maximum.load(std::memory_order_relaxed);
+        while (value > seen && !maximum.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+        }
+    }
+    
+    uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+    double mean() const { return count() == 0 ? 0.0 : static_cast<double>(total_sum.load(std::memory_order_relaxed)) / count(); }
+    
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint64_t percentile(double pct) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(std::ceil(pct / 100.0 * total));
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= target) return std::min(upperBound(i), max());
+        }
+        return max();
+    }
+
+private:
+    static const size_t bucket_count = 61 * 16;
+    std::array<std::atomic<uint64_t>, bucket_count> counts{};
+    std::atomic<uint64_t> total_count{0};
+    std::atomic<uint64_t> total_sum{0};
+    std::atomic<uint64_t> maximum{0};
+    
+    static size_t indexOf(uint64_t value) {
+        if (value < 16) return static_cast<size_t>(value);
+        int msb = 63 - __builtin_clzll(value);
+        return static_cast<size_t>(msb - 3) * 16 + ((value >> (msb - 4)) & 15);
+    }
+    
+    static uint64_t upperBound(size_t index) {
+        if (index < 16) return index;
+        int msb = static_cast<int>(index / 16) + 3;
+        return (static_cast<uint64_t>(16 + index % 16 + 1) << (msb - 4)) - 1;
+    }
+};
+
+inline uint64_t microsecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+// Hardware counters per engine stage, summed over every thread that ran the
+// stage. Filled by PerfScope when a run asks for hardware counters.
+class HardwareProfile {
+public:
+    enum Counter { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, COUNTER_COUNT };
+    enum Stage { STAGE_PARSE, STAGE_COMPILE, STAGE_MATCH, STAGE_WRITE, STAGE_COUNT };
+    
+    void reset(bool enable) {
+        enabled.store(enable, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(reason_mutex);
+        reason.clear();
+        for (auto& stage : stages) {
+            for (auto& value : stage) value.store(0, std::memory_order_relaxed);
+        }
+        for (auto& seen : counter_seen) seen.store(false, std::memory_order_relaxed);
+    }
+    
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    
+    // The first failure turns profiling off for the rest of the run
+    void disable(const std::string& why) {
+        std::lock_guard<std::mutex> lock(reason_mutex);
+        if (reason.empty()) reason = why;
+        enabled.store(false, std::memory_order_relaxed);
+    }
+    
+    void add(Stage stage, Counter counter, uint64_t value) {
+        stages[stage][counter].fetch_add(value, std::memory_order_relaxed);
+        counter_seen[counter].store(true, std::memory_order_relaxed);
+    }
+    
+    // Totals, IPC and counts per historical row for each stage
+    std::string toJson(uint64_t rows) const {
+        static const char* counter_names[COUNTER_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+        static const char* stage_names[STAGE_COUNT] = {"parse", "compile", "match", "write"};
+        std::ostringstream json;
+        std::string why;
+        {
+            std::lock_guard<std::mutex> lock(reason_mutex);
+            why = reason;
+        }
+        json << "{\"available\": " << (why.empty() ? "true" : "false");
+        if (!why.empty()) json << ", \"reason\": \"" << jsonEscape(why) << "\"";
+        for (size_t s = 0; s < STAGE_COUNT; ++s) {
+            json << ", \"" << stage_names[s] << "\": {";
+            bool first = true;
+            for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+                if (!counter_seen[c].load(std::memory_order_relaxed)) continue;
+                uint64_t value = stages[s][c].load(std::memory_order_relaxed);
+                json << (first ? "" : ", ") << "\"" << counter_names[c] << "\": " << value;
+                if (rows > 0) {
+                    json << ", \"" << counter_names[c] << "_per_row\": " << static_cast<double>(value) / rows;
+                }
+                first = false;
+            }
+            uint64_t cycles = stages[s][CYCLES].load(std::memory_order_relaxed);
+            if (cycles > 0 && counter_seen[INSTRUCTIONS].load(std::memory_order_relaxed)) {
+                json << ", \"ipc\": " << static_cast<double>(stages[s][INSTRUCTIONS].load(std::memory_order_relaxed)) / cycles;
+            }
+            json << "}";
+        }
+        json << "}";
+        return json.str();
+    }
+
+private:
+    std::atomic<bool> enabled{false};
+    std::array<std::array<std::atomic<uint64_t>, COUNTER_COUNT>, STAGE_COUNT> stages{};
+    std::array<std::atomic<bool>, COUNTER_COUNT> counter_seen{};
+    mutable std::mutex reason_mutex;
+    std::string reason;
+};
+
+// Counts the calling thread's hardware events for the enclosing scope and
+// adds them to a stage of the profile. Does nothing when profile is null or
+// disabled. Counters the CPU or the kernel won't give us are left out; if
+// even cycles can't be opened (perf_event_paranoid, containers, VMs without
+// a PMU) profiling is disabled with the reason.
+class PerfScope {
+public:
+    PerfScope(HardwareProfile* profile, HardwareProfile::Stage stage) : profile(profile), stage(stage) {
+        fds.fill(-1);
+#ifdef __linux__
+        if (!profile || !profile->isEnabled()) return;
+        static const std::pair<uint32_t, uint64_t> events[HardwareProfile::COUNTER_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (size_t c = 0; c < HardwareProfile::COUNTER_COUNT; ++c) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[c].first;
+            attr.config = events[c].second;
+            attr.disabled = fds[0] < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, fds[0], 0));
+            if (c == 0 && fds[0] < 0) {
+                profile->disable(std::string("perf_event_open: ") + strerror(errno));
+                return;
+            }
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+    
+    ~PerfScope() {
+#ifdef __linux__
+        if (fds[0] < 0) return;
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        // Group read: nr, time enabled, time running, then one value per open counter
+        uint64_t data[3 + HardwareProfile::COUNTER_COUNT] = {};
+        if (read(fds[0], data, sizeof(data)) > 0 && data[2] > 0) {
+            double scale = static_cast<double>(data[1]) / data[2];   // Counters were multiplexed
+            size_t slot = 3;
+            for (size_t c = 0; c < HardwareProfile::COUNTER_COUNT && slot < 3 + data[0]; ++c) {
+                if (fds[c] < 0) continue;
+                profile->add(stage, static_cast<HardwareProfile::Counter>(c), static_cast<uint64_t>(data[slot++] * scale));
+            }
+        }
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+    
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    HardwareProfile* profile;
+    HardwareProfile::Stage stage;
+    std::array<int, HardwareProfile::COUNTER_COUNT> fds;
+};
+
+// Per-file numbers of a run. Latencies are in microseconds.
+struct FileMetrics {
+    std::string name;
+    uint64_t bytes = 0;
+    uint64_t rows = 0;
+    uint64_t patterns_evaluated = 0;    // Pattern x daily row checks
+    uint64_t matches = 0;
+    uint64_t parse_us = 0;
+    uint64_t compile_us = 0;
+    uint64_t match_us = 0;
+    uint64_t write_us = 0;
+    uint64_t footprint_bytes = 0;       // Raw rows (unless streamed) plus compiled patterns
+    bool streamed = false;              // Compiled line by line to stay within the memory budget
+    uint64_t blocks_skipped = 0;        // Pattern blocks whose zone maps ruled out every slate
+    uint64_t rows_dropped = 0;          // Rows the pattern filter left out (not in rows)
+};
+
+// Memory side of a run: allocations per stage (AllocationStage order), peak
+// RSS and the footprints of the engine's main structures
+struct MemoryMetrics {
+    uint64_t allocations[ALLOC_STAGE_COUNT] = {};
+    uint64_t allocated_bytes[ALLOC_STAGE_COUNT] = {};
+    uint64_t peak_rss_bytes = 0;
+    uint64_t budget_bytes = 0;
+    uint64_t daily_slates_bytes = 0;
+    uint64_t dictionaries_bytes = 0;
+    uint64_t peak_file_bytes = 0;       // Largest historical file footprint
+    uint64_t peak_result_bytes = 0;     // Largest per-file match lists and output buffer
+    size_t streamed_files = 0;
+    bool over_budget = false;           // Even streaming didn't fit
+    
+    // Snapshot of the process-wide counters, diffed at the end of the run
+    void startAllocations() {
+        for (size_t i = 0; i < ALLOC_STAGE_COUNT; ++i) {
+            allocations[i] = g_allocation_counters.count[i].load();
+            allocated_bytes[i] = g_allocation_counters.bytes[i].load();
+        }
+    }
+    
+    void finishAllocations() {
+        for (size_t i = 0; i < ALLOC_STAGE_COUNT; ++i) {
+            allocations[i] = g_allocation_counters.count[i].load() - allocations[i];
+            allocated_bytes[i] = g_allocation_counters.bytes[i].load() - allocated_bytes[i];
+        }
+    }
+};
+
+// Metrics of one processBatch run, written as JSON next to the outputs so
+// nightly runs can be compared file by file
+class RunMetrics {
+public:
+    std::vector<std::string> daily_files;
+    std::vector<FileMetrics> files;
+    LatencyHistogram parse_us;
+    LatencyHistogram compile_us;
+    LatencyHistogram match_us;
+    LatencyHistogram write_us;
+    double elapsed_seconds = 0;
+    double first_match_seconds = -1;    // Until the first file with matches was done; -1 if none
+    size_t thread_count = 0;
+    bool cancelled = false;
+    uint64_t files_skipped = 0;     // Not read: their indexed zone maps ruled out every slate
+    uint64_t files_resumed = 0;     // Replayed from the checkpoint of an interrupted attempt
+    uint64_t files_cached = 0;      // Not read: every pair was in the result cache
+    const HardwareProfile* hardware = nullptr;  // Set when the run collected hardware counters
+    MemoryMetrics memory;
+    
+    void add(const FileMetrics& file) {
+        files.push_back(file);
+        parse_us.record(file.parse_us);
+        compile_us.record(file.compile_us);
+        match_us.record(file.match_us);
+        write_us.record(file.write_us);
+    }
+    
+    std::string toJson() const {
+        uint64_t bytes = 0;
+        uint64_t rows = 0;
+        uint64_t evaluated = 0;
+        uint64_t matches = 0;
+        uint64_t blocks_skipped = 0;
+        uint64_t rows_dropped = 0;
+        for (const FileMetrics& file : files) {
+            bytes += file.bytes;
+            rows += file.rows;
+            evaluated += file.patterns_evaluated;
+            matches += file.matches;
+            blocks_skipped += file.blocks_skipped;
+            rows_dropped += file.rows_dropped;
+        }
+        double seconds = std::max(elapsed_seconds, 1e-9);
+        
+        std::ostringstream json;
+        json << "{\n  \"daily_files\": [";
+        for (size_t i = 0; i < daily_files.size(); ++i) {
+            json << (i ? ", " : "") << '"' << jsonEscape(daily_files[i]) << '"';
+        }
+        json << "],\n  \"threads\": " << thread_count << ",\n  \"cancelled\": " << (cancelled ? "true" : "false")
+             << ",\n  \"elapsed_seconds\": " << elapsed_seconds << ",\n  \"first_match_seconds\": " << first_match_seconds
+             << ",\n  \"files\": " << files.size()
+             << ",\n  \"files_skipped\": " << files_skipped << ",\n  \"files_resumed\": " << files_resumed
+             << ",\n  \"files_cached\": " << files_cached << ",\n  \"blocks_skipped\": " << blocks_skipped
+             << ",\n  \"bytes\": " << bytes << ",\n  \"rows\": " << rows << ",\n  \"rows_dropped\": " << rows_dropped
+             << ",\n  \"patterns_evaluated\": " << evaluated << ",\n  \"matches\": " << matches
+             << ",\n  \"rows_per_sec\": " << rows / seconds
+             << ",\n  \"mb_per_sec\": " << bytes / seconds / (1024.0 * 1024.0) << ",\n  \"latency_us\": {\n";
+        const std::pair<const char*, const LatencyHistogram*> stages[] = {
+            {"parse", &parse_us}, {"compile", &compile_us}, {"match", &match_us}, {"write", &write_us}};
+        for (size_t i = 0; i < 4; ++i) {
+            const LatencyHistogram& h = *stages[i].second;
+            json << "    \"" << stages[i].first << "\": {\"count\": " << h.count() << ", \"mean\": " << h.mean()
+                 << ", \"p50\": " << h.percentile(50) << ", \"p90\": " << h.percentile(90)
+                 << ", \"p99\": " << h.percentile(99) << ", \"max\": " << h.max() << "}" << (i < 3 ? ",\n" : "\n");
+        }
+        json << "  },\n";
+        if (hardware) json << "  \"hardware_counters\": " << hardware->toJson(rows) << ",\n";
+        static const char* stage_names[ALLOC_STAGE_COUNT] = {"other", "daily", "parse", "compile", "match", "write"};
+        json << "  \"memory\": {\"peak_rss_bytes\": " << memory.peak_rss_bytes << ", \"budget_bytes\": " << memory.budget_bytes
+             << ", \"over_budget\": " << (memory.over_budget ? "true" : "false")
+             << ", \"streamed_files\": " << memory.streamed_files
+             << ",\n    \"footprints\": {\"daily_slates\": " << memory.daily_slates_bytes
+             << ", \"dictionaries\": " << memory.dictionaries_bytes << ", \"peak_historical_file\": " << memory.peak_file_bytes
+             << ", \"peak_result_buffers\": " << memory.peak_result_bytes << "},\n    \"allocation_tracking\": "
+             << (allocationTracking() ? "true" : "false") << ", \"allocations\": {";
+        for (size_t i = 0; i < ALLOC_STAGE_COUNT; ++i) {
+            json << (i ? ", " : "") << "\"" << stage_names[i] << "\": {\"count\": " << memory.allocations[i]
+                 << ", \"bytes\": " << memory.allocated_bytes[i] << "}";
+        }
+        json << "}},\n";
+        json << "  \"per_file\": [";
+        for (size_t i = 0; i < files.size(); ++i) {
+            const FileMetrics& f = files[i];
+            json << (i ? ",\n    " : "\n    ") << "{\"name\": \"" << jsonEscape(f.name) << "\", \"bytes\": " << f.bytes
+                 << ", \"rows\": " << f.rows << ", \"patterns_evaluated\": " << f.patterns_evaluated
+                 << ", \"matches\": " << f.matches << ", \"parse_us\": " << f.parse_us
+                 << ", \"compile_us\": " << f.compile_us << ", \"match_us\": " << f.match_us
+                 << ", \"write_us\": " << f.write_us << ", \"footprint_bytes\": " << f.footprint_bytes
+                 << ", \"streamed\": " << (f.streamed ? "true" : "false")
+                 << ", \"blocks_skipped\": " << f.blocks_skipped << ", \"rows_dropped\": " << f.rows_dropped << "}";
+        }
+        json << "\n  ]\n}\n";
+        return json.str();
+    }
+};
+
+// Which historical files a time-budgeted run matched, written as
+// <daily>_Coverage.json next to its (possibly partial) results. Every row of
+// a covered file was checked, except in the file the budget ran out in:
+// that one is marked partial and its rows count only those checked.
+struct RunCoverage {
+    struct File {
+        std::string name;
+        uint64_t rows = 0;      // Compiled rows checked
+        bool skipped = false;   // Ruled out by its indexed zone map without being read
+        bool partial = false;   // The budget ran out while its rows were checked
+    };
+    double time_budget_seconds = 0;
+    double elapsed_seconds = 0;
+    std::vector<File> covered;          // In the order they were matched
+    std::vector<std::string> not_covered;
+    
+    bool complete() const {
+        return not_covered.empty() &&
+               std::none_of(covered.begin(), covered.end(), [](const File& file) { return file.partial; });
+    }
+    
+    std::string toJson() const {
+        std::ostringstream json;
+        json << "{\n  \"complete\": " << (complete() ? "true" : "false")
+             << ",\n  \"time_budget_seconds\": " << time_budget_seconds << ",\n  \"elapsed_seconds\": " << elapsed_seconds
+             << ",\n  \"files_covered\": " << covered.size()
+             << ",\n  \"files_total\": " << covered.size() + not_covered.size() << ",\n  \"covered\": [";
+        for (size_t i = 0; i < covered.size(); ++i) {
+            json << (i ? "," : "") << "\n    {\"file\": \"" << jsonEscape(covered[i].name) << "\", \"rows\": " << covered[i].rows
+                 << ", \"skipped\": " << (covered[i].skipped ? "true" : "false")
+                 << ", \"partial\": " << (covered[i].partial ? "true" : "false") << "}";
+        }
+        json << (covered.empty() ? "" : "\n  ") << "],\n  \"not_covered\": [";
+        for (size_t i = 0; i < not_covered.size(); ++i) {
+            json << (i ? "," : "") << "\n    \"" << jsonEscape(not_covered[i]) << "\"";
+        }
+        json << (not_covered.empty() ? "" : "\n  ") << "]\n}\n";
+        return json.str();
+    }
+};
+
+// Matches of earlier runs per (daily player, historical file), so a rerun
+// only matches the files whose version, or whose players' filtered daily
+// rows, changed since. One file per historical file in results/ under the
+// folder's cache directory (cacheDirectoryFor): its version, the results for the
+// last few fingerprints of each of its players (as historical row and
+// ordinal among the player's daily rows) and the text of the matched rows.
+// The daily rows themselves are re-rendered, so output changes outside the
+// filtered columns don't invalidate anything.
+class ResultCache {
+public:
+    struct Match {
+        uint32_t row;       // Historical row
+        uint32_t ordinal;   // Among the player's daily rows
+    };
+    
+    struct Entry {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t filter = 0;
+        uint64_t rows_checked = 0;
+        std::vector<uint64_t> players;      // Sorted player name hashes of the file
+        std::vector<std::pair<uint64_t, std::vector<Match>>> results;   // By fingerprint, most recent first
+        std::unordered_map<uint32_t, std::string> rows;                 // Historical row -> text
+        
+        const std::vector<Match>* find(uint64_t fingerprint) const {
+            for (const auto& [key, matches] : results) {
+                if (key == fingerprint) return &matches;
+            }
+            return nullptr;
+        }
+        
+        void put(uint64_t fingerprint, std::vector<Match> matches) {
+            results.erase(std::remove_if(results.begin(), results.end(),
+                [fingerprint](const auto& result) { return result.first == fingerprint; }), results.end());
+            results.insert(results.begin(), {fingerprint, std::move(matches)});
+            if (results.size() > max_results) results.resize(max_results);
+        }
+    };
+    
+    static std::string directoryFor(const std::string& historical_folder, const std::string& cache_root = "") {
+        std::string directory = cacheDirectoryFor(historical_folder, cache_root);
+        if (directory.empty()) {
+            throw std::runtime_error("No cache directory for the result cache: set HOME or give a cache directory");
+        }
+        return (std::filesystem::path(directory) / "results").string();
+    }
+    
+    explicit ResultCache(const std::string& cache_directory) : directory(cache_directory) {}
+    
+    bool has(const std::string& file_name) const { return std::filesystem::exists(pathFor(file_name)); }
+    
+    // An empty entry when there is none for this version of the file
+    Entry load(const std::string& file_name, uint64_t size, int64_t mtime, uint64_t filter) const {
+        Entry entry;
+        std::ifstream in(pathFor(file_name), std::ios::binary);
+        if (!in.is_open()) return fresh(size, mtime, filter);
+        try {
+            char header[sizeof(magic)];
+            if (!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0) {
+                return fresh(size, mtime, filter);
+            }
+            entry.size = readPod<uint64_t>(in);
+            entry.mtime = readPod<int64_t>(in);
+            entry.filter = readPod<uint64_t>(in);
+            if (entry.size != size || entry.mtime != mtime || entry.filter != filter) return fresh(size, mtime, filter);
+            entry.rows_checked = readPod<uint64_t>(in);
+            entry.players.resize(readPod<uint32_t>(in));
+            for (uint64_t& player : entry.players) player = readPod<uint64_t>(in);
+            entry.results.resize(readPod<uint32_t>(in));
+            for (auto& [fingerprint, matches] : entry.results) {
+                fingerprint = readPod<uint64_t>(in);
+                matches.resize(readPod<uint32_t>(in));
+                for (Match& match : matches) {
+                    match.row = readPod<uint32_t>(in);
+                    match.ordinal = readPod<uint32_t>(in);
+                }
+            }
+            uint32_t row_count = readPod<uint32_t>(in);
+            for (uint32_t i = 0; i < row_count; ++i) {
+                uint32_t row = readPod<uint32_t>(in);
+                entry.rows[row] = readString(in);
+            }
+        } catch (const std::exception&) {
+            return fresh(size, mtime, filter);
+        }
+        return entry;
+    }
+    
+    // Best effort: the cache only saves time
+    void save(const std::string& file_name, const Entry& entry) const {
+        std::ostringstream out(std::ios::binary);
+        out.write(magic, sizeof(magic));
+        writePod<uint64_t>(out, entry.size);
+        writePod<int64_t>(out, entry.mtime);
+        writePod<uint64_t>(out, entry.filter);
+        writePod<uint64_t>(out, entry.rows_checked);
+        writePod<uint32_t>(out, static_cast<uint32_t>(entry.players.size()));
+        for (uint64_t player : entry.players) writePod<uint64_t>(out, player);
+        writePod<uint32_t>(out, static_cast<uint32_t>(entry.results.size()));
+        std::set<uint32_t> used_rows;
+        for (const auto& [fingerprint, matches] : entry.results) {
+            writePod<uint64_t>(out, fingerprint);
+            writePod<uint32_t>(out, static_cast<uint32_t>(matches.size()));
+            for (const Match& match : matches) {
+                writePod<uint32_t>(out, match.row);
+                writePod<uint32_t>(out, match.ordinal);
+                used_rows.insert(match.row);
+            }
+        }
+        // Rows only evicted results referred to are dropped
+        writePod<uint32_t>(out, static_cast<uint32_t>(used_rows.size()));
+        for (uint32_t row : used_rows) {
+            writePod<uint32_t>(out, row);
+            writeString(out, entry.rows.at(row));
+        }
+        try {
+            std::filesystem::create_directories(directory);
+            writeFileAtomically(pathFor(file_name), out.str());
+        } catch (const std::exception&) {
+        }
+    }
+
+private:
+    static constexpr char magic[8] = {'M', 'R', 'E', 'S', 'U', 'L', 'T', '1'};
+    static constexpr size_t max_results = 8;    // Fingerprints kept per file
+    
+    std::string directory;
+    
+    std::string pathFor(const std::string& file_name) const {
+        return (std::filesystem::path(directory) / (file_name + ".res")).string();
+    }
+    
+    static Entry fresh(uint64_t size, int64_t mtime, uint64_t filter) {
+        Entry entry;
+        entry.size = size;
+        entry.mtime = mtime;
+        entry.filter = filter;
+        return entry;
+    }
+};
+
+// Journal of an interrupted run: rerunning the same daily files against the
+// same corpus redoes only the historical files the earlier attempt didn't
+// finish. Each finished file is a unit <file index>.unit holding its output
+// rows for every daily file, written atomically, so a crash loses at most
+// the files in flight. The manifest holds the run's signature; the journal of
+// a different run is cleared. Only a new or empty directory, or one holding a
+// manifest, is used, and only the journal's own files are ever deleted.
+class RunCheckpoint {
+public:
+    struct Unit {
+        uint64_t rows_checked = 0;
+        std::vector<uint64_t> match_counts;     // Per daily file
+        std::vector<std::string> rows;          // Per daily file, in the output format
+    };
+    
+    RunCheckpoint(const std::string& checkpoint_directory, uint64_t signature) : directory(checkpoint_directory) {
+        std::string manifest = directory + "/manifest";
+        bool ours = false;
+        bool current = false;
+        {
+            std::ifstream in(manifest, std::ios::binary);
+            char header[sizeof(magic)];
+            uint64_t saved = 0;
+            ours = in.read(header, sizeof(header)) && std::memcmp(header, magic, sizeof(magic)) == 0;
+            current = ours && in.read(reinterpret_cast<char*>(&saved), sizeof(saved)) && saved == signature;
+        }
+        if (!ours && std::filesystem::exists(directory) &&
+            (!std::filesystem::is_directory(directory) || !std::filesystem::is_empty(directory))) {
+            throw std::runtime_error("Not a checkpoint directory (not empty, no manifest): " + directory);
+        }
+        if (!current) {
+            removeJournal();
+            std::filesystem::create_directories(directory);
+            std::ostringstream out(std::ios::binary);
+            out.write(magic, sizeof(magic));
+            writePod<uint64_t>(out, signature);
+            writeFileAtomically(manifest, out.str());
+        }
+    }
+    
+    bool has(size_t file_index) const { return std::filesystem::exists(unitPath(file_index)); }
+    
+    // False when the file has no (complete) unit
+    bool load(size_t file_index, size_t daily_count, Unit& unit) const {
+        std::ifstream in(unitPath(file_index), std::ios::binary);
+        if (!in.is_open()) return false;
+        Unit loaded;
+        try {
+            loaded.rows_checked = readPod<uint64_t>(in);
+            if (readPod<uint32_t>(in) != daily_count) return false;
+            loaded.match_counts.resize(daily_count);
+            loaded.rows.resize(daily_count);
+            for (size_t s = 0; s < daily_count; ++s) {
+                loaded.match_counts[s] = readPod<uint64_t>(in);
+                loaded.rows[s] = readString(in);
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+        unit = std::move(loaded);
+        return true;
+    }
+    
+    void save(size_t file_index, const Unit& unit) const {
+        std::ostringstream out(std::ios::binary);
+        writePod<uint64_t>(out, unit.rows_checked);
+        writePod<uint32_t>(out, static_cast<uint32_t>(unit.rows.size()));
+        for (size_t s = 0; s < unit.rows.size(); ++s) {
+            writePod<uint64_t>(out, unit.match_counts[s]);
+            writeString(out, unit.rows[s]);
+        }
+        writeFileAtomically(unitPath(file_index), out.str());
+    }
+    
+    // Once the outputs are published the journal has served its purpose. The
+    // directory goes too unless something else was put in it.
+    void remove() const {
+        removeJournal();
+        std::error_code not_empty;
+        std::filesystem::remove(directory, not_empty);
+    }
+
+private:
+    static constexpr char magic[8] = {'M', 'C', 'H', 'E', 'C', 'K', 'P', '1'};
+    
+    std::string directory;
+    
+    // The manifest and <file index>.unit files, with their temporaries
+    void removeJournal() const {
+        if (!std::filesystem::is_directory(directory)) return;
+        std::vector<std::filesystem::path> journal;
+        for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+            std::filesystem::path name = entry.path().filename();
+            if (name.extension() == ".tmp") name = name.stem();
+            std::string stem = name.stem().string();
+            bool unit = name.extension() == ".unit" && !stem.empty() &&
+                        std::all_of(stem.begin(), stem.end(), [](char c) { return c >= '0' && c <= '9'; });
+            if ((unit || name == "manifest") && entry.is_regular_file()) journal.push_back(entry.path());
+        }
+        for (const std::filesystem::path& path : journal) std::filesystem::remove(path);
+    }
+    
+    std::string unitPath(size_t file_index) const { return directory + "/" + std::to_string(file_index) + ".unit"; }
+};
+
+// Drops low-information historical rows while compiling, so they are never
+// indexed or evaluated. The defaults keep every row.
+struct PatternFilter {
+    double min_total = 0;               // Rows with a lower Total are dropped
+    double min_win_percent = 0;         // Rows with a lower WinPercent (a 0-1 fraction) are dropped
+    uint32_t max_rows_per_player = 0;   // Per file, keeps a player's highest Total (then WinPercent) rows; 0 = all
+    
+    bool active() const { return min_total > 0 || min_win_percent > 0 || max_rows_per_player > 0; }
+    bool thresholds() const { return min_total > 0 || min_win_percent > 0; }
+    
+    // Rows whose statistics don't parse fail any threshold
+    bool accepts(const std::string& total, const std::string& win_percent) const {
+        double value = 0;
+        if (min_total > 0 && (!parseStatistic(total, value) || value < min_total)) return false;
+        if (min_win_percent > 0 && (!parseStatistic(win_percent, value) || value < min_win_percent)) return false;
+        return true;
+    }
+    
+    // Identifies the filter in persisted zone maps; 0 when inactive
+    uint64_t signature() const {
+        if (!active()) return 0;
+        uint64_t total_bits = 0;
+        uint64_t win_bits = 0;
+        std::memcpy(&total_bits, &min_total, sizeof(double));
+        std::memcpy(&win_bits, &min_win_percent, sizeof(double));
+        return mixHash(mixHash(total_bits) ^ (win_bits + 0x9E3779B97F4A7C15ULL)) ^ max_rows_per_player;
+    }
+    
+    static bool parseStatistic(const std::string& text, double& value) {
+        if (text.empty()) return false;
+        char* end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        return end == text.c_str() + text.size() && !std::isnan(value);
+    }
+};
+
+// Running summary of one daily player's matches: how many, summed Total,
+// Total-weighted WinPercent and the strongest pattern (highest Total, then
+// WinPercent, then first in output order)
+struct PlayerAggregate {
+    uint64_t matches = 0;
+    double total = 0;
+    double weighted_win = 0;        // Sum of Total x WinPercent
+    double best_total = 0;
+    double best_win_percent = 0;
+    uint32_t best_file = 0;         // Index into the run's historical files
+    uint32_t best_row = 0;          // Row in that file
+    
+    void add(double row_total, double win_percent, uint32_t file, uint32_t row) {
+        if (matches == 0 || row_total > best_total || (row_total == best_total && win_percent > best_win_percent)) {
+            best_total = row_total;
+            best_win_percent = win_percent;
+            best_file = file;
+            best_row = row;
+        }
+        matches++;
+        total += row_total;
+        weighted_win += row_total * win_percent;
+    }
+    
+    // other summarizes matches that come after this one's in output order
+    void merge(const PlayerAggregate& other) {
+        if (other.matches == 0) return;
+        if (matches == 0 || other.best_total > best_total ||
+            (other.best_total == best_total && other.best_win_percent > best_win_percent)) {
+            best_total = other.best_total;
+            best_win_percent = other.best_win_percent;
+            best_file = other.best_file;
+            best_row = other.best_row;
+        }
+        matches += other.matches;
+        total += other.total;
+        weighted_win += other.weighted_win;
+    }
+    
+    // Total and WinPercent are the last two cells of a row rendered by
+    // CSVReader::appendCSVRow; unparsable ones count as 0
+    static void rowStatistics(std::string_view row_text, double& total, double& win_percent) {
+        auto cell = [](std::string_view text) {
+            if (text.size() >= 2 && text.front() == '"' && text.back() == '"') text = text.substr(1, text.size() - 2);
+            return std::string(text);
+        };
+        size_t last = row_text.rfind(',');
+        size_t before = last == std::string_view::npos || last == 0 ? std::string_view::npos : row_text.rfind(',', last - 1);
+        total = 0;
+        win_percent = 0;
+        if (before == std::string_view::npos) return;
+        if (!PatternFilter::parseStatistic(cell(row_text.substr(before + 1, last - before - 1)), total)) total = 0;
+        if (!PatternFilter::parseStatistic(cell(row_text.substr(last + 1)), win_percent)) win_percent = 0;
+    }
+};
+
+// A match competing for a player's top K
+struct RankedMatch {
+    double win_percent = 0;
+    double total = 0;
+    uint32_t file = 0;      // Index into the run's historical files
+    uint32_t row = 0;       // Row in that file
+    uint32_t daily = 0;     // Daily row
+    uint32_t pattern = 0;   // Pattern index, valid while its file is compiled
+    std::string text;       // The historical row, copied once the match outlives its file's chunks
+    
+    // Higher WinPercent first, then higher Total, then output order
+    bool rankedBefore(const RankedMatch& other) const {
+        if (win_percent != other.win_percent) return win_percent > other.win_percent;
+        if (total != other.total) return total > other.total;
+        return std::tie(file, row, daily) < std::tie(other.file, other.row, other.daily);
+    }
+};
+
+// Bounded min-heap keeping the best k matches offered: the worst kept match
+// sits on top, so a better one replaces it in O(log k)
+class TopK {
+public:
+    explicit TopK(size_t k = 0) : limit(k) {}
+    
+    void offer(RankedMatch&& match) {
+        if (limit == 0) return;
+        if (heap.size() < limit) {
+            heap.push_back(std::move(match));
+            std::push_heap(heap.begin(), heap.end(), before);
+        } else if (match.rankedBefore(heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), before);
+            heap.back() = std::move(match);
+            std::push_heap(heap.begin(), heap.end(), before);
+        }
+    }
+    
+    std::vector<RankedMatch>& entries() { return heap; }
+    const std::vector<RankedMatch>& entries() const { return heap; }
+    
+    // Best first
+    std::vector<RankedMatch> ranked() const {
+        std::vector<RankedMatch> sorted = heap;
+        std::sort(sorted.begin(), sorted.end(), before);
+        return sorted;
+    }
+
+private:
+    static bool before(const RankedMatch& a, const RankedMatch& b) { return a.rankedBefore(b); }
+    
+    size_t limit;
+    std::vector<RankedMatch> heap;
+};
+
+class DataProcessor {
+private:
+    std::mutex matches_mutex;
+    
+public:
+    struct RowData {
+        std::string player;
+        std::map<std::string, std::string> data;
+        std::string total;
+        std::string winPercent;
+    };
+    
+    RowData parseRowToDict(const Row& row) {
+        RowData data;
+        if (row.empty()) return data;
+        
+        data.player = row[0];
+        
+        // Parse pairs of key-value starting from index 1
+        for (size_t i = 1; i + 2 < row.size(); i += 2) {
+            data.data[row[i]] = row[i + 1];
+        }
+        
+        if (row.size() >= 2) {
+            data.total = row[row.size() - 2];
+            data.winPercent = row[row.size() - 1];
+        }
+        
+        return data;
+    }
+    
+    // Parses a "low-high" degree bucket such as "010-014"
+    static bool parseDegreeRange(const std::string& hist_range, int& low, int& high) {
+        size_t dash = hist_range.find('-');
+        if (dash == std::string::npos || dash == 0 || dash + 1 == hist_range.size()) return false;
+        long long bounds[2] = {0, 0};
+        size_t pos = 0;
+        for (int part = 0; part < 2; ++part) {
+            size_t stop = part == 0 ? dash : hist_range.size();
+            for (; pos < stop; ++pos) {
+                char c = hist_range[pos];
+                if (c < '0' || c > '9') return false;
+                bounds[part] = bounds[part] * 10 + (c - '0');
+                if (bounds[part] > INT32_MAX) return false;
+            }
+            pos = dash + 1;
+        }
+        low = static_cast<int>(bounds[0]);
+        high = static_cast<int>(bounds[1]);
+        return true;
+    }
+    
+    // Compiles historical rows into interned predicates. Daily slates must be
+    // compiled first so their values are already in the dictionaries, and
+    // observed first so predicates come out most selective first.
+    CompiledFile compileRows(const DataFrame& raw_hist_df) {
+        TRACE_SCOPE("compile", std::to_string(raw_hist_df.size()) + " rows");
+        CompiledFile file;
+        file.patterns.reserve(raw_hist_df.size());
+        for (size_t r = 0; r < raw_hist_df.size(); ++r) {
+            compileRow(file, raw_hist_df[r], static_cast<uint32_t>(r));
+        }
+        capRowsPerPlayer(file);
+        return file;
+    }
+    
+    // Appends historical row number source_row to file as the next pattern,
+    // unless the pattern filter drops it
+    void compileRow(CompiledFile& file, const Row& row, uint32_t source_row) {
+        RowData hist_row = parseRowToDict(row);
+        if (filter.thresholds() && !filter.accepts(hist_row.total, hist_row.winPercent)) {
+            file.rows_dropped++;
+            return;
+        }
+        
+        CompiledPattern pattern;
+        pattern.player = players.intern(hist_row.player);
+        pattern.row = source_row;
+        pattern.pred_begin = static_cast<uint32_t>(file.predicates.size());
+        for (const auto& [col, hist_val] : hist_row.data) {
+            if (col == "WinPercent" || col == "Total" || hist_val.empty()) continue;
+            auto col_it = std::find(daily_cols.begin(), daily_cols.end(), col);
+            if (col_it == daily_cols.end()) continue;
+            
+            Predicate pred;
+            pred.col = static_cast<uint8_t>(std::distance(daily_cols.begin(), col_it));
+            pred.a = 0;
+            pred.b = 0;
+            if (std::find(degree_cols.begin(), degree_cols.end(), col) != degree_cols.end()) {
+                pred.kind = parseDegreeRange(hist_val, pred.a, pred.b) ? PRED_DEGREE : PRED_NEVER;
+            } else {
+                pred.kind = PRED_EQUAL;
+                pred.a = values.intern(hist_val);
+            }
+            file.predicates.push_back(pred);
+        }
+        pattern.pred_count = static_cast<uint32_t>(file.predicates.size()) - pattern.pred_begin;
+        selectivity.orderPredicates(file.predicates.data() + pattern.pred_begin, pattern.pred_count);
+        
+        pattern.text_begin = static_cast<uint32_t>(file.text.size());
+        CSVReader::appendCSVRow(file.text, row);
+        pattern.text_length = static_cast<uint32_t>(file.text.size()) - pattern.text_begin;
+        file.patterns.push_back(pattern);
+    }
+    
+    // Compiles a CSV line by line without materializing its DataFrame; same
+    // rows as CSVReader::readCSV. Used when a memory budget is tight.
+    CompiledFile compileStream(const std::string& file_path) {
+        TRACE_SCOPE("compile stream", std::filesystem::path(file_path).filename().string());
+        CSVLineReader reader(file_path);
+        CompiledFile file;
+        std::string line;
+        uint32_t source_row = 0;
+        while (reader.next(line)) {
+            Row row = CSVReader::parseCSVLine(line);
+            if (!row.empty()) compileRow(file, row, source_row++);
+        }
+        capRowsPerPlayer(file);
+        return file;
+    }
+    
+    // Applies max_rows_per_player: keeps each player's strongest patterns by
+    // Total, then WinPercent, then row order, and compacts the file in order
+    void capRowsPerPlayer(CompiledFile& file) {
+        if (filter.max_rows_per_player == 0) return;
+        std::unordered_map<int32_t, std::vector<uint32_t>> by_player;
+        for (uint32_t idx = 0; idx < file.patterns.size(); ++idx) {
+            by_player[file.patterns[idx].player].push_back(idx);
+        }
+        std::vector<uint8_t> keep(file.patterns.size(), 1);
+        for (auto& [player, indices] : by_player) {
+            if (indices.size() <= filter.max_rows_per_player) continue;
+            std::vector<std::pair<std::pair<double, double>, uint32_t>> ranked;
+            for (uint32_t idx : indices) {
+                Row row = CSVReader::parseCSVLine(std::string(file.rowText(file.patterns[idx])));
+                RowData data = parseRowToDict(row);
+                // Unparsable statistics (text, NaN) rank last and keep the ordering strict
+                double total = 0;
+                double win_percent = 0;
+                if (!PatternFilter::parseStatistic(data.total, total)) total = -HUGE_VAL;
+                if (!PatternFilter::parseStatistic(data.winPercent, win_percent)) win_percent = -HUGE_VAL;
+                ranked.push_back({{-total, -win_percent}, idx});
+            }
+            std::nth_element(ranked.begin(), ranked.begin() + filter.max_rows_per_player, ranked.end());
+            for (size_t r = filter.max_rows_per_player; r < ranked.size(); ++r) keep[ranked[r].second] = 0;
+        }
+        
+        CompiledFile capped;
+        capped.rows_dropped = file.rows_dropped;
+        for (uint32_t idx = 0; idx < file.patterns.size(); ++idx) {
+            if (!keep[idx]) {
+                capped.rows_dropped++;
+                continue;
+            }
+            CompiledPattern pattern = file.patterns[idx];
+            const Predicate* preds = file.predicates.data() + pattern.pred_begin;
+            pattern.pred_begin = static_cast<uint32_t>(capped.predicates.size());
+            capped.predicates.insert(capped.predicates.end(), preds, preds + pattern.pred_count);
+            std::string_view text = file.rowText(file.patterns[idx]);
+            pattern.text_begin = static_cast<uint32_t>(capped.text.size());
+            capped.text += text;
+            capped.patterns.push_back(pattern);
+        }
+        file = std::move(capped);
+    }
+    
+    // Fills the parse and compile latencies and the footprint of metrics when
+    // given. Streaming (CSV only) parses and compiles in one pass, all of
+    // which is charged to the compile stage. A read already started by the
+    // caller is taken from prefetched; the parse stage then only waits on it.
+    CompiledFile compileFile(const std::string& file_path, FileMetrics* metrics = nullptr, bool streaming = false,
+                             std::future<DataFrame>* prefetched = nullptr) {
+        auto started = std::chrono::steady_clock::now();
+        auto parsed = started;
+        CompiledFile file;
+        size_t raw_footprint = 0;
+        if (streaming && !prefetched && CSVReader::isCSV(file_path)) {
+            PerfScope perf(profiling ? &hardware_profile : nullptr, HardwareProfile::STAGE_COMPILE);
+            AllocationScope allocations(ALLOC_COMPILE);
+            file = compileStream(file_path);
+        } else {
+            DataFrame raw_hist_df;
+            {
+                PerfScope perf(profiling ? &hardware_profile : nullptr, HardwareProfile::STAGE_PARSE);
+                AllocationScope allocations(ALLOC_PARSE);
+                raw_hist_df = prefetched ? prefetched->get() : CSVReader::readCSV(file_path);
+            }
+            parsed = std::chrono::steady_clock::now();
+            {
+                PerfScope perf(profiling ? &hardware_profile : nullptr, HardwareProfile::STAGE_COMPILE);
+                AllocationScope allocations(ALLOC_COMPILE);
+                file = compileRows(raw_hist_df);
+            }
+            if (metrics) raw_footprint = dataFrameFootprint(raw_hist_df);
+            streaming = false;
+        }
+        if (metrics) {
+            metrics->parse_us = microsecondsBetween(started, parsed);
+            metrics->compile_us = microsecondsBetween(parsed, std::chrono::steady_clock::now());
+            metrics->streamed = streaming;
+            metrics->footprint_bytes = raw_footprint + file.footprint();
+        }
+        file.path = file_path;
+        file.name = std::filesystem::path(file_path).filename().string();
+        file.bytes = std::filesystem::file_size(file_path);
+        buildZones(file);
+        return file;
+    }
+    
+    // Summarizes the file and each block of zone_block patterns
+    void buildZones(CompiledFile& file) {
+        TRACE_SCOPE("zone maps", file.name);
+        ZoneBuilder whole;
+        std::vector<uint64_t> keys;
+        int32_t last_player = -1;
+        uint64_t player_hash = 0;
+        file.blocks.clear();
+        for (size_t begin = 0; begin < file.patterns.size(); begin += CompiledFile::zone_block) {
+            size_t end = std::min<size_t>(begin + CompiledFile::zone_block, file.patterns.size());
+            ZoneBuilder block;
+            for (size_t idx = begin; idx < end; ++idx) {
+                const CompiledPattern& pattern = file.patterns[idx];
+                if (pattern.player != last_player) {
+                    last_player = pattern.player;
+                    player_hash = hashText(players.name(pattern.player));
+                }
+                const Predicate* preds = file.predicates.data() + pattern.pred_begin;
+                keys.resize(pattern.pred_count);
+                for (uint32_t p = 0; p < pattern.pred_count; ++p) {
+                    keys[p] = preds[p].kind == PRED_EQUAL ? zoneKey(preds[p].col, valueHash(preds[p].a)) : 0;
+                }
+                block.add(player_hash, preds, pattern.pred_count, keys.data());
+                whole.add(player_hash, preds, pattern.pred_count, keys.data());
+            }
+            file.blocks.push_back(block.finish());
+        }
+        file.zone = whole.finish();
+    }
+    
+    // The slates' rows as zone maps check them
+    ZoneProbe buildZoneProbe(const std::vector<DailySlate>& slates) {
+        ZoneProbe probe;
+        for (const DailySlate& slate : slates) {
+            for (size_t player = 0; player < slate.rows_by_player.size(); ++player) {
+                if (slate.rows_by_player[player].empty()) continue;
+                uint64_t player_hash = hashText(players.name(static_cast<int32_t>(player)));
+                for (uint32_t i : slate.rows_by_player[player]) {
+                    ZoneRow row;
+                    for (size_t c = 0; c < slate.cells[i].size(); ++c) {
+                        const DailyCell& cell = slate.cells[i][c];
+                        if (!cell.present) continue;
+                        row.present |= 1u << c;
+                        // Values the corpus never saw can't be required by any pattern
+                        if (cell.value >= 0) row.keys[c] = zoneKey(c, valueHash(cell.value));
+                        if (cell.degree_valid) {
+                            row.degree_valid |= 1u << c;
+                            row.degrees[c] = cell.degree;
+                        }
+                    }
+                    probe.add(player_hash, row);
+                }
+            }
+        }
+        return probe;
+    }
+    
+    // One flag per block of the file: 0 if its zone map rules out every slate
+    static std::vector<uint8_t> liveBlocks(const CompiledFile& file, const ZoneProbe& probe, uint64_t& skipped) {
+        std::vector<uint8_t> live(file.blocks.size());
+        for (size_t b = 0; b < file.blocks.size(); ++b) {
+            live[b] = file.blocks[b].mayMatch(probe);
+            if (!live[b]) skipped++;
+        }
+        return live;
+    }
+    
+    // With lookup_only the dictionaries are left untouched, which lets many
+    // threads compile slates against an already loaded corpus. Players and
+    // values the corpus has never seen can't match anything anyway.
+    DailySlate compileDailySlate(const std::string& daily_file, const DataFrame& raw_daily_df,
+                                 bool lookup_only = false) {
+        TRACE_SCOPE("compile daily", std::filesystem::path(daily_file).filename().string());
+        DataFrame daily_df = filterDailyData(raw_daily_df);
+        DailySlate slate;
+        slate.daily_file = daily_file;
+        slate.rendered.resize(daily_df.size());
+        slate.cells.resize(daily_df.size());
+        for (size_t i = 0; i < daily_df.size(); ++i) {
+            const Row& daily_row = daily_df[i];
+            CSVReader::appendCSVRow(slate.rendered[i], raw_daily_df[i]);
+            if (daily_row.empty()) continue;
+            
+            int32_t player = lookup_only ? players.find(daily_row[0]) : players.intern(daily_row[0]);
+            if (player < 0) continue;
+            if (static_cast<size_t>(player) >= slate.rows_by_player.size()) {
+                slate.rows_by_player.resize(player + 1);
+                slate.fingerprints.resize(player + 1, 0);
+            }
+            slate.rows_by_player[player].push_back(static_cast<uint32_t>(i));
+            // Only the filtered cells decide matches; the other columns just get printed
+            uint64_t row_hash = 0;
+            for (const std::string& cell : daily_row) row_hash = mixHash(row_hash ^ hashText(cell)) + 1;
+            slate.fingerprints[player] = mixHash(slate.fingerprints[player] + row_hash);
+            
+            for (size_t c = 0; c < daily_cols.size(); ++c) {
+                size_t col_idx = c + 1; // +1 for Player column
+                if (col_idx >= daily_row.size() || daily_row[col_idx].empty()) continue;
+                DailyCell& cell = slate.cells[i][c];
+                cell.present = true;
+                cell.value = lookup_only ? values.find(daily_row[col_idx]) : values.intern(daily_row[col_idx]);
+                try {
+                    cell.degree = std::stoi(daily_row[col_idx]);
+                    cell.degree_valid = true;
+                } catch (...) {
+                    cell.degree_valid = false;
+                }
+            }
+        }
+        return slate;
+    }
+    
+    static bool patternMatches(const Predicate* preds, uint32_t count, const std::array<DailyCell, 22>& cells) {
+        for (uint32_t p = 0; p < count; ++p) {
+            const Predicate& pred = preds[p];
+            const DailyCell& cell = cells[pred.col];
+            if (!cell.present) continue;
+            switch (pred.kind) {
+                case PRED_EQUAL:
+                    if (cell.value != pred.a) return false;
+                    break;
+                case PRED_DEGREE:
+                    if (!cell.degree_valid || cell.degree < pred.a || cell.degree > pred.b) return false;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+    
+    // Checks patterns [begin, end) of a file against every slate while the
+    // pattern is hot in cache, calling on_match(slate, pattern index, daily
+    // row) for each match. Blocks flagged 0 in live_blocks are skipped whole.
+    template <typename OnMatch>
+    void scanChunk(const CompiledFile& file, size_t begin, size_t end, const std::vector<DailySlate>& slates,
+                   const std::vector<uint8_t>* live_blocks, OnMatch&& on_match) {
+        TRACE_SCOPE("match chunk", file.name + " " + std::to_string(begin) + "-" + std::to_string(end));
+        PerfScope perf(profiling ? &hardware_profile : nullptr, HardwareProfile::STAGE_MATCH);
+        AllocationScope allocations(ALLOC_MATCH);
+        
+        // Counters are flushed in batches so workers touch the shared
+        // cache lines rarely; cancellation and the deadline are polled at
+        // the same points.
+        const size_t flush_interval = 4096;
+        uint64_t pending_rows = 0;
+        uint64_t pending_matches = 0;
+        uint64_t pending_evaluated = 0;
+        for (size_t idx = begin; idx < end; ++idx) {
+            size_t block = idx / CompiledFile::zone_block;
+            if (live_blocks && (idx == begin || idx % CompiledFile::zone_block == 0) && !(*live_blocks)[block]) {
+                size_t block_end = std::min<size_t>((block + 1) * CompiledFile::zone_block, end);
+                pending_rows += block_end - idx;
+                idx = block_end - 1;
+                continue;
+            }
+            if (pending_rows >= flush_interval) {
+                progress.rows_scanned.add(pending_rows);
+                progress.matches_found.add(pending_matches);
+                progress.patterns_evaluated.add(pending_evaluated);
+                pending_rows = 0;
+                pending_matches = 0;
+                pending_evaluated = 0;
+                if (cancel_token.isCancelled()) break;
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    rows_past_deadline.add(end - idx);
+                    break;
+                }
+            }
+            pending_rows++;
+            
+            const CompiledPattern& pattern = file.patterns[idx];
+            const Predicate* preds = file.predicates.data() + pattern.pred_begin;
+            for (size_t s = 0; s < slates.size(); ++s) {
+                const std::vector<uint32_t>* daily_rows = slates[s].rowsFor(pattern.player);
+                if (!daily_rows) continue;
+                pending_evaluated += daily_rows->size();
+                for (uint32_t i : *daily_rows) {
+                    if (patternMatches(preds, pattern.pred_count, slates[s].cells[i])) {
+                        pending_matches++;
+                        on_match(s, static_cast<uint32_t>(idx), i);
+                    }
+                }
+            }
+        }
+        progress.rows_scanned.add(pending_rows);
+        progress.matches_found.add(pending_matches);
+        progress.patterns_evaluated.add(pending_evaluated);
+    }
+    
+    // Returns one match list per slate
+    std::vector<std::vector<MatchRef>> processChunk(const CompiledFile& file, size_t begin, size_t end,
+                                                    const std::vector<DailySlate>& slates,
+                                                    const std::vector<uint8_t>* live_blocks = nullptr) {
+        std::vector<std::vector<MatchRef>> matches(slates.size());
+        scanChunk(file, begin, end, slates, live_blocks, [&matches](size_t s, uint32_t pattern, uint32_t daily) {
+            matches[s].push_back({pattern, daily});
+        });
+        return matches;
+    }
+    
+    // Splits a file's patterns into thread_count chunks run in parallel by
+    // work(begin, end). Returns the chunks' results in pattern order.
+    template <typename ChunkWork>
+    auto runChunks(const CompiledFile& file, ChunkWork work) {
+        using Result = decltype(work(size_t(), size_t()));
+        size_t pattern_count = file.patterns.size();
+        size_t num_threads = std::max<size_t>(1, std::min<size_t>(thread_count, pattern_count));
+        size_t chunk_size = std::max<size_t>(1, std::ceil(static_cast<double>(pattern_count) / num_threads));
+        std::vector<std::future<Result>> futures;
+        for (size_t i = 0; i < pattern_count; i += chunk_size) {
+            size_t end = std::min(i + chunk_size, pattern_count);
+            futures.push_back(std::async(std::launch::async, work, i, end));
+        }
+        std::vector<Result> results;
+        for (auto& future : futures) results.push_back(future.get());
+        return results;
+    }
+    
+    // Matches a file's patterns in parallel chunks. Returns one match list
+    // per slate, in pattern order.
+    std::vector<std::vector<MatchRef>> matchFile(const CompiledFile& file, const std::vector<DailySlate>& slates,
+                                                 const std::vector<uint8_t>* live_blocks = nullptr) {
+        AllocationScope allocations(ALLOC_MATCH);
+        auto chunks = runChunks(file, [this, &file, &slates, live_blocks](size_t begin, size_t end) {
+            return processChunk(file, begin, end, slates, live_blocks);
+        });
+        
+        // Collect results in chunk order
+        std::vector<std::vector<MatchRef>> matches(slates.size());
+        for (const auto& chunk_matches : chunks) {
+            TRACE_SCOPE("merge", file.name);
+            for (size_t s = 0; s < slates.size(); ++s) {
+                matches[s].insert(matches[s].end(), chunk_matches[s].begin(), chunk_matches[s].end());
+            }
+        }
+        return matches;
+    }
+    
+    // One accumulator per player id for each slate
+    using PlayerAggregates = std::vector<std::vector<PlayerAggregate>>;
+    
+    // Folds a file's matches into aggregates without listing them: each
+    // chunk fills its own accumulators, merged in chunk order so the result
+    // doesn't depend on timing. file_index identifies the file in the summary.
+    uint64_t aggregateFile(const CompiledFile& file, uint32_t file_index, const std::vector<DailySlate>& slates,
+                           const std::vector<uint8_t>* live_blocks, PlayerAggregates& aggregates) {
+        AllocationScope allocations(ALLOC_MATCH);
+        auto chunks = runChunks(file, [this, &file, file_index, &slates, live_blocks](size_t begin, size_t end) {
+            PlayerAggregates local(slates.size());
+            uint64_t match_count = 0;
+            scanChunk(file, begin, end, slates, live_blocks, [&](size_t s, uint32_t idx, uint32_t) {
+                const CompiledPattern& pattern = file.patterns[idx];
+                if (local[s].empty()) local[s].resize(slates[s].rows_by_player.size());
+                double total = 0;
+                double win_percent = 0;
+                PlayerAggregate::rowStatistics(file.rowText(pattern), total, win_percent);
+                local[s][pattern.player].add(total, win_percent, file_index, pattern.row);
+                match_count++;
+            });
+            return std::make_pair(std::move(local), match_count);
+        });
+        
+        uint64_t match_count = 0;
+        for (const auto& [local, chunk_count] : chunks) {
+            match_count += chunk_count;
+            for (size_t s = 0; s < slates.size(); ++s) {
+                if (local[s].empty()) continue;
+                if (aggregates[s].size() < local[s].size()) aggregates[s].resize(local[s].size());
+                for (size_t player = 0; player < local[s].size(); ++player) aggregates[s][player].merge(local[s][player]);
+            }
+        }
+        return match_count;
+    }
+    
+    // One bounded heap per player id for each slate
+    using PlayerTopK = std::vector<std::vector<TopK>>;
+    
+    // Offers a file's matches to each player's top k. Chunks keep their own
+    // heaps, merged in chunk order; the rows that make it into top are
+    // copied while the file is still compiled.
+    uint64_t rankFile(const CompiledFile& file, uint32_t file_index, const std::vector<DailySlate>& slates,
+                      const std::vector<uint8_t>* live_blocks, size_t k, PlayerTopK& top) {
+        AllocationScope allocations(ALLOC_MATCH);
+        auto chunks = runChunks(file, [this, &file, file_index, &slates, live_blocks, k](size_t begin, size_t end) {
+            PlayerTopK local(slates.size());
+            uint64_t match_count = 0;
+            scanChunk(file, begin, end, slates, live_blocks, [&](size_t s, uint32_t idx, uint32_t daily) {
+                const CompiledPattern& pattern = file.patterns[idx];
+                if (local[s].empty()) local[s].assign(slates[s].rows_by_player.size(), TopK(k));
+                RankedMatch match;
+                PlayerAggregate::rowStatistics(file.rowText(pattern), match.total, match.win_percent);
+                match.file = file_index;
+                match.row = pattern.row;
+                match.daily = daily;
+                match.pattern = idx;
+                local[s][pattern.player].offer(std::move(match));
+                match_count++;
+            });
+            return std::make_pair(std::move(local), match_count);
+        });
+        
+        uint64_t match_count = 0;
+        for (auto& [local, chunk_count] : chunks) {
+            match_count += chunk_count;
+            for (size_t s = 0; s < slates.size(); ++s) {
+                if (local[s].empty()) continue;
+                if (top[s].size() < local[s].size()) top[s].resize(local[s].size(), TopK(k));
+                for (size_t player = 0; player < local[s].size(); ++player) {
+                    for (RankedMatch& match : local[s][player].entries()) top[s][player].offer(std::move(match));
+                }
+            }
+        }
+        for (auto& slate_top : top) {
+            for (TopK& heap : slate_top) {
+                for (RankedMatch& match : heap.entries()) {
+                    if (match.file == file_index && match.text.empty()) {
+                        match.text = std::string(file.rowText(file.patterns[match.pattern]));
+                    }
+                }
+            }
+        }
+        return match_count;
+    }
+    
+    // Daily players (ids) in order of first appearance in the daily file
+    static std::vector<int32_t> dailyPlayerOrder(const DailySlate& slate) {
+        std::vector<std::pair<uint32_t, int32_t>> first_rows;
+        for (size_t player = 0; player < slate.rows_by_player.size(); ++player) {
+            if (!slate.rows_by_player[player].empty()) {
+                first_rows.emplace_back(slate.rows_by_player[player].front(), static_cast<int32_t>(player));
+            }
+        }
+        std::sort(first_rows.begin(), first_rows.end());
+        std::vector<int32_t> order;
+        for (const auto& [row, player] : first_rows) order.push_back(player);
+        return order;
+    }
+    
+    // Each player's top matches, best first, in the _Matches.csv layout
+    static std::string renderTopK(const DailySlate& slate, const std::vector<TopK>& top, size_t& row_count) {
+        std::string output;
+        row_count = 0;
+        for (int32_t player : dailyPlayerOrder(slate)) {
+            if (static_cast<size_t>(player) >= top.size()) continue;
+            for (const RankedMatch& match : top[player].ranked()) {
+                output += slate.rendered[match.daily];
+                output += ',';
+                output += match.text;
+                output += '\n';
+                row_count++;
+            }
+        }
+        return output;
+    }
+    
+    // One row per daily player, in order of first appearance in the daily file
+    std::string renderSummary(const DailySlate& slate, const std::vector<PlayerAggregate>& aggregates,
+                              const std::vector<std::string>& file_names) {
+        auto number = [](double value) {
+            std::ostringstream text;
+            text.precision(10);
+            text << value;
+            return text.str();
+        };
+        std::string output;
+        CSVReader::appendCSVRow(output, {"Player", "DailyRows", "Matches", "Total", "WinPercent",
+                                         "BestFile", "BestRow", "BestTotal", "BestWinPercent"});
+        output += '\n';
+        PlayerAggregate none;
+        for (int32_t player : dailyPlayerOrder(slate)) {
+            const PlayerAggregate& aggregate = static_cast<size_t>(player) < aggregates.size() ? aggregates[player] : none;
+            Row row = {players.name(player), std::to_string(slate.rows_by_player[player].size()),
+                       std::to_string(aggregate.matches), number(aggregate.total)};
+            row.push_back(aggregate.total != 0 ? number(aggregate.weighted_win / aggregate.total) : "");
+            if (aggregate.matches > 0) {
+                row.insert(row.end(), {file_names[aggregate.best_file], std::to_string(aggregate.best_row),
+                                       number(aggregate.best_total), number(aggregate.best_win_percent)});
+            } else {
+                row.insert(row.end(), {"", "", "", ""});
+            }
+            CSVReader::appendCSVRow(output, row);
+            output += '\n';
+        }
+        return output;
+    }
+    
+    DataFrame filterDailyData(const DataFrame& raw_daily_df) {
+        TRACE_SCOPE("filter daily", std::to_string(raw_daily_df.size()) + " rows");
+        DataFrame filtered_data;
+        
+        for (const Row& row : raw_daily_df) {
+            Row filtered_row;
+            
+            // Extract column 0 (Player)
+            if (!row.empty()) {
+                filtered_row.push_back(row[0]);
+            }
+            
+            // Extract columns 41-62 (indices 41-62)
+            for (int i = 41; i <= 62 && i < static_cast<int>(row.size()); ++i) {
+                filtered_row.push_back(row[i]);
+            }
+            
+            // Keep empty rows as placeholders so indices line up with raw_daily_df
+            filtered_data.push_back(filtered_row);
+        }
+        
+        return filtered_data;
+    }
+    
+    static bool isInputFile(const std::filesystem::path& path) {
+        std::string ext = path.extension().string();
+        return ext == ".csv" || ext == ".xlsx" ||
+               (CSVLineReader::compression_supported && CSVLineReader::isCompressed(path.string()) &&
+                path.stem().extension() == ".csv");
+    }
+    
+    // Historical files in name order so every run visits them identically
+    static std::vector<std::string> listHistoricalFiles(const std::string& historical_folder) {
+        std::vector<std::string> files;
+        for (const auto& entry : std::filesystem::directory_iterator(historical_folder)) {
+            if (entry.is_regular_file() && isInputFile(entry.path())) {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+    
+    // Expands folders of daily files (e.g. a date range) and skips our own outputs
+    static std::vector<std::string> listDailyFiles(const std::vector<std::string>& inputs) {
+        std::vector<std::string> files;
+        for (const std::string& input : inputs) {
+            if (!std::filesystem::is_directory(input)) {
+                files.push_back(input);
+                continue;
+            }
+            std::vector<std::string> folder_files;
+            for (const auto& entry : std::filesystem::directory_iterator(input)) {
+                std::string stem = entry.path().stem().string();
+                if (entry.is_regular_file() && isInputFile(entry.path()) &&
+                    !(stem.size() >= 8 && stem.compare(stem.size() - 8, 8, "_Matches") == 0)) {
+                    folder_files.push_back(entry.path().string());
+                }
+            }
+            std::sort(folder_files.begin(), folder_files.end());
+            files.insert(files.end(), folder_files.begin(), folder_files.end());
+        }
+        return files;
+    }
+    
+    static std::string outputPathFor(const std::string& daily_file) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_Matches.csv";
+    }
+    
+    static std::string topPathFor(const std::string& daily_file, uint32_t k) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_Top" + std::to_string(k) + ".csv";
+    }
+    
+    // Added matches: "+",player,file,pattern_row, then the _Matches.csv row.
+    // Dropped matches: "-",player,file,pattern_row.
+    static std::string deltaPathFor(const std::string& daily_file) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_Delta.csv";
+    }
+    
+    static std::string coveragePathFor(const std::string& daily_file) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_Coverage.json";
+    }
+    
+    static std::string summaryPathFor(const std::string& daily_file) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_Summary.csv";
+    }
+    
+    static std::string metricsPathFor(const std::string& daily_file) {
+        return daily_file.substr(0, daily_file.find_last_of('.')) + "_Metrics.json";
+    }
+    
+    struct RunResult {
+        std::string output_path;    // Empty when nothing matched
+        size_t match_count = 0;
+        bool cancelled = false;
+        bool partial = false;       // The time budget ran out; see coverage_path
+        std::string coverage_path;  // Set for time-budgeted runs
+    };
+    
+    // Optional extras of a run; the defaults reproduce the plain _Matches.csv run
+    struct RunOptions {
+        std::string hit_matrix_path;    // Write the pattern x day hit matrix here
+        std::string trace_path;         // Write a Chrome trace here (MATCHER_TRACE builds)
+        std::string metrics_path;       // Empty: <first daily>_Metrics.json next to its output
+        bool hardware_counters = false; // perf_event counters per stage into the metrics (Linux)
+        uint64_t memory_budget = 0;     // Bytes; 0 = unlimited. Over it, files are compiled streaming
+        bool zone_index = true;         // Skip files and blocks whose zone maps rule the slates out,
+                                        // keeping file zone maps in the folder's cache directory
+        std::string cache_dir;          // Root of the cache directories (cacheDirectoryFor); empty =
+                                        // the per-user cache
+        PatternFilter filter;           // Historical rows to drop while compiling
+        bool summary = false;           // Write <daily>_Summary.csv, one row per daily player, instead of
+                                        // every match; matches are folded as found and never stored
+        uint32_t top_k = 0;             // > 0: write only each player's top_k matches by WinPercent, then
+                                        // Total, to <daily>_Top<K>.csv, keeping O(players x K) of them
+        bool normalized = false;        // Write the matches as <daily>_Matches/ tables (NormalizedOutput)
+        bool match_set = false;         // Also save each day's <daily>_MatchSet.bin
+        std::string previous_match_set; // Set: write only the matches added or dropped since this
+                                        // saved MatchSet to <daily>_Delta.csv; implies match_set
+        double time_budget_seconds = 0; // > 0: stop matching after this long, even inside a file; what
+                                        // was matched is published, with a <daily>_Coverage.json (RunCoverage)
+        // Called with each file's output rows for a daily file as soon as the
+        // file is matched, long before the outputs are published. Not for the
+        // summary, top-K or normalized modes.
+        std::function<void(const std::string& daily_file, const std::string& rows)> on_matches;
+        std::string checkpoint_dir;     // Set: journal finished files here (RunCheckpoint) and resume
+                                        // from it; removed once the run completes. Match list only.
+        bool result_cache = false;      // Reuse and keep per (player, file) results (ResultCache)
+                                        // in the folder's cache directory. Match list only.
+    };
+    
+    EngineProgress& getProgress() { return progress; }
+    const HardwareProfile& getHardwareProfile() const { return hardware_profile; }
+    CancellationToken& getCancelToken() { return cancel_token; }
+    SelectivityStats& getSelectivity() { return selectivity; }
+    void setPatternFilter(const PatternFilter& pattern_filter) { filter = pattern_filter; }
+    const PatternFilter& getPatternFilter() const { return filter; }
+    void setThreadCount(size_t count) { thread_count = std::max<size_t>(1, count); }
+    size_t getThreadCount() const { return thread_count; }
+    
+    RunResult processFiles(const std::string& daily_file, const std::string& historical_folder) {
+        return processBatch({daily_file}, historical_folder).front();
+    }
+    
+    std::vector<RunResult> processBatch(const std::vector<std::string>& daily_inputs, const std::string& historical_folder) {
+        return processBatch(daily_inputs, historical_folder, RunOptions());
+    }
+    
+    // Matches any number of daily files in one pass over the historical
+    // folder: each historical file is read and compiled once, then every
+    // pattern is checked against all slates. Writes one output per daily file.
+    // Runs without touching any UI; callers observe it through getProgress()
+    // and stop it through getCancelToken().
+    std::vector<RunResult> processBatch(const std::vector<std::string>& daily_inputs, const std::string& historical_folder,
+                                        const RunOptions& options) {
+        auto run_started = std::chrono::steady_clock::now();
+        RunMetrics metrics;
+        metrics.memory.startAllocations();
+        metrics.memory.budget_bytes = options.memory_budget;
+        resetPeakResident();
+        progress.reset();
+        players = StringDictionary();
+        values = StringDictionary();
+        value_hashes.clear();
+        selectivity = SelectivityStats();
+        filter = options.filter;
+        traceReset();
+        profiling = options.hardware_counters;
+        hardware_profile.reset(profiling);
+#ifndef __linux__
+        if (profiling) hardware_profile.disable("hardware counters need Linux perf_event");
+#endif
+        
+        // Check if files exist
+        if (!std::filesystem::exists(historical_folder)) {
+            throw std::runtime_error("One or both files not found.");
+        }
+        std::vector<std::string> daily_files = listDailyFiles(daily_inputs);
+        if (daily_files.empty()) {
+            throw std::runtime_error("No daily files found.");
+        }
+        
+        // Read daily files (now supports .csv and .xlsx)
+        std::vector<DailySlate> slates;
+        for (const std::string& daily_file : daily_files) {
+            if (!std::filesystem::exists(daily_file)) {
+                throw std::runtime_error("One or both files not found.");
+            }
+            AllocationScope allocations(ALLOC_DAILY);
+            slates.push_back(compileDailySlate(daily_file, CSVReader::readCSV(daily_file)));
+            selectivity.observe(slates.back());
+            metrics.memory.daily_slates_bytes += slates.back().footprint();
+        }
+        
+        std::vector<std::string> hist_files = listHistoricalFiles(historical_folder);
+        progress.files_total.store(hist_files.size());
+        
+        ZoneProbe probe;
+        ZoneIndex zone_index;
+        if (options.zone_index) {
+            probe = buildZoneProbe(slates);
+            zone_index = ZoneIndex::load(ZoneIndex::pathFor(historical_folder, options.cache_dir));
+            zone_index.retain(hist_files);
+        }
+        
+        std::vector<RunResult> results(slates.size());
+        std::vector<std::ofstream> outputs(slates.size());
+        std::string buffer;
+        
+        metrics.daily_files = daily_files;
+        metrics.thread_count = thread_count;
+        if (profiling) metrics.hardware = &hardware_profile;
+        
+        bool record_hits = !options.hit_matrix_path.empty();
+        if (record_hits && filter.active()) {
+            throw std::runtime_error("A hit matrix numbers every historical row; it can't be recorded with a pattern filter");
+        }
+        if (record_hits && (options.summary || options.top_k > 0)) {
+            throw std::runtime_error("A hit matrix needs every match; it can't be recorded in summary or top-K mode");
+        }
+        if (options.summary && options.top_k > 0) {
+            throw std::runtime_error("Summary and top-K modes can't be combined");
+        }
+        if (options.normalized && (options.summary || options.top_k > 0)) {
+            throw std::runtime_error("Normalized output is only for the full match list, not summary or top-K mode");
+        }
+        std::vector<std::unique_ptr<NormalizedOutput>> normalized(slates.size());
+        bool delta = !options.previous_match_set.empty();
+        bool save_match_sets = options.match_set || delta;
+        if (save_match_sets && (options.summary || options.top_k > 0)) {
+            throw std::runtime_error("A match set needs every match; it can't be saved in summary or top-K mode");
+        }
+        if (delta && options.normalized) {
+            throw std::runtime_error("Delta and normalized output can't be combined");
+        }
+        if (delta && slates.size() != 1) {
+            throw std::runtime_error("A delta is taken against one previous day; give a single daily file");
+        }
+        MatchSet previous_matches = delta ? MatchSet::load(options.previous_match_set) : MatchSet();
+        std::vector<MatchSet> match_sets(save_match_sets ? slates.size() : 0);
+        if (options.on_matches && (options.summary || options.top_k > 0 || options.normalized)) {
+            throw std::runtime_error("Only the full match list or a delta can be streamed");
+        }
+        if (options.time_budget_seconds > 0 && (record_hits || save_match_sets)) {
+            throw std::runtime_error("A hit matrix or match set needs every file; it can't be taken under a time budget");
+        }
+        // Streamed or time-budgeted runs of the match list (or delta) visit the
+        // daily players' files first; on publish each file's rows are put back
+        // in folder order
+        bool prioritize = (options.time_budget_seconds > 0 || options.on_matches) && options.zone_index &&
+                          !options.summary && options.top_k == 0 && !options.normalized;
+        std::vector<size_t> visit_order(hist_files.size());
+        std::iota(visit_order.begin(), visit_order.end(), 0);
+        if (prioritize) visit_order = priorityOrder(hist_files, slates, zone_index);
+        std::vector<std::vector<OutputPiece>> pieces(slates.size());
+        std::vector<uint64_t> output_bytes(slates.size(), 0);
+        RunCoverage coverage;
+        coverage.time_budget_seconds = options.time_budget_seconds;
+        deadline = options.time_budget_seconds > 0
+            ? run_started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(options.time_budget_seconds))
+            : std::chrono::steady_clock::time_point::max();
+        std::vector<uint8_t> covered(hist_files.size(), 0);
+        bool out_of_time = false;
+        std::unique_ptr<RunCheckpoint> checkpoint;
+        if (!options.checkpoint_dir.empty()) {
+            if (record_hits || options.summary || options.top_k > 0 || options.normalized || save_match_sets) {
+                throw std::runtime_error("Checkpoints cover the plain match list only");
+            }
+            // The run is identified by the daily rows, the corpus files' versions and the filter
+            std::string identity = std::to_string(filter.signature()) + '\n';
+            for (const DailySlate& slate : slates) {
+                identity += slate.daily_file + '\n';
+                for (const std::string& row : slate.rendered) identity += row + '\n';
+            }
+            for (const std::string& path : hist_files) {
+                identity += path + '\n' + std::to_string(std::filesystem::file_size(path)) + ' ' +
+                            std::to_string(ZoneIndex::modificationTime(path)) + '\n';
+            }
+            checkpoint = std::make_unique<RunCheckpoint>(options.checkpoint_dir, hashText(identity));
+        }
+        std::unique_ptr<ResultCache> result_cache;
+        std::vector<std::unordered_map<uint64_t, int32_t>> slate_players(slates.size());    // Name hash -> player id
+        std::vector<std::vector<uint32_t>> daily_ordinals(slates.size());                   // Daily row -> ordinal
+        if (options.result_cache) {
+            if (record_hits || options.summary || options.top_k > 0 || options.normalized || save_match_sets) {
+                throw std::runtime_error("The result cache covers the plain match list only");
+            }
+            result_cache = std::make_unique<ResultCache>(ResultCache::directoryFor(historical_folder, options.cache_dir));
+            for (size_t s = 0; s < slates.size(); ++s) {
+                daily_ordinals[s].resize(slates[s].rendered.size());
+                for (size_t player = 0; player < slates[s].rows_by_player.size(); ++player) {
+                    const std::vector<uint32_t>& rows = slates[s].rows_by_player[player];
+                    if (rows.empty()) continue;
+                    slate_players[s].emplace(hashText(players.name(static_cast<int32_t>(player))), static_cast<int32_t>(player));
+                    for (uint32_t ordinal = 0; ordinal < rows.size(); ++ordinal) daily_ordinals[s][rows[ordinal]] = ordinal;
+                }
+            }
+        }
+        auto appendOutput = [&](size_t s, size_t file_index, const std::string& rows) {
+            if (!outputs[s].is_open()) {
+                results[s].output_path = delta ? deltaPathFor(slates[s].daily_file) : outputPathFor(slates[s].daily_file);
+                outputs[s].open(results[s].output_path + ".tmp", std::ios::binary);
+                if (!outputs[s].is_open()) {
+                    throw std::runtime_error("Cannot create file: " + results[s].output_path);
+                }
+            }
+            if (prioritize) {
+                pieces[s].push_back({file_index, output_bytes[s], rows.size()});
+                output_bytes[s] += rows.size();
+            }
+            outputs[s] << rows;
+            if (options.on_matches && !rows.empty()) options.on_matches(slates[s].daily_file, rows);
+        };
+        PlayerAggregates aggregates(slates.size());
+        PlayerTopK top(slates.size());
+        HitMatrix matrix;
+        if (record_hits) {
+            for (const DailySlate& slate : slates) {
+                matrix.days.push_back(std::filesystem::path(slate.daily_file).stem().string());
+            }
+            matrix.hits.resize(slates.size());
+        }
+        
+        // Decompression is CPU-bound, so the next few compressed files are read
+        // and inflated in the background while the current one is matched.
+        // Each one is held as a whole DataFrame until its turn, so the window
+        // is capped by estimated in-memory bytes as well as by count, and a
+        // file too large for the cap on its own is never read ahead.
+        // Uncompressed .csv files get no read-ahead: reading them is I/O the
+        // page cache already overlaps. Files the zone index rules out, or a
+        // checkpoint or the result cache already covers, are left alone. Off
+        // under a memory budget, whose accounting assumes one file in memory
+        // at a time.
+        // Reads still in flight when the loop ends (time budget, cancel,
+        // error) are stopped and waited for, so they end with the run.
+        std::unordered_map<size_t, std::future<DataFrame>> read_ahead;
+        CancellationToken read_ahead_stop;
+        struct ReadAheadDrain {
+            std::unordered_map<size_t, std::future<DataFrame>>& reads;
+            CancellationToken& stop;
+            void operator()() {
+                stop.cancel();
+                for (auto& [index, read] : reads) {
+                    if (read.valid()) read.wait();
+                }
+                reads.clear();
+            }
+            ~ReadAheadDrain() { (*this)(); }
+        } drain_read_ahead{read_ahead, read_ahead_stop};
+        std::unordered_map<size_t, uint64_t> read_ahead_sizes;   // Estimated in-memory bytes per read
+        uint64_t read_ahead_bytes = 0;
+        size_t read_ahead_next = 0;     // Position in visit_order
+        auto readAhead = [&](size_t position) {
+            if (options.memory_budget > 0 || record_hits) return;
+            read_ahead_next = std::max(read_ahead_next, position + 1);
+            while (read_ahead.size() < readAheadWindow(thread_count) && read_ahead_next < visit_order.size()) {
+                size_t next = visit_order[read_ahead_next];
+                const std::string& path = hist_files[next];
+                uint64_t estimate = std::filesystem::file_size(path) * compressed_expansion * in_memory_expansion;
+                if (CSVLineReader::isCompressed(path) && estimate <= read_ahead_byte_limit &&
+                    read_ahead_bytes + estimate > read_ahead_byte_limit) {
+                    break;      // Wait for the reads in flight to be consumed
+                }
+                ++read_ahead_next;
+                if (!CSVLineReader::isCompressed(path) || estimate > read_ahead_byte_limit) continue;
+                if (checkpoint && checkpoint->has(next)) continue;
+                if (result_cache && result_cache->has(std::filesystem::path(path).filename().string())) continue;
+                if (options.zone_index) {
+                    const ZoneMap* zone = zone_index.find(std::filesystem::path(path).filename().string(),
+                                                          std::filesystem::file_size(path),
+                                                          ZoneIndex::modificationTime(path), filter.signature());
+                    if (zone && !zone->mayMatch(probe)) continue;
+                }
+                read_ahead.emplace(next, std::async(std::launch::async, [path, &read_ahead_stop] {
+                    return CSVReader::readCSV(path, &read_ahead_stop);
+                }));
+                read_ahead_sizes[next] = estimate;
+                read_ahead_bytes += estimate;
+            }
+        };
+        
+        // Process each file in historical folder
+        for (size_t position = 0; position < visit_order.size(); ++position) {
+            size_t file_index = visit_order[position];
+            const std::string& file_path = hist_files[file_index];
+            if (cancel_token.isCancelled()) break;
+            if (options.time_budget_seconds > 0 &&
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - run_started).count() >= options.time_budget_seconds) {
+                out_of_time = true;
+                break;
+            }
+            std::future<DataFrame> prefetched;
+            if (auto ahead = read_ahead.find(file_index); ahead != read_ahead.end()) {
+                prefetched = std::move(ahead->second);
+                read_ahead.erase(ahead);
+                read_ahead_bytes -= read_ahead_sizes[file_index];
+                read_ahead_sizes.erase(file_index);
+            }
+            readAhead(position);
+            // Files an interrupted attempt finished are replayed from the checkpoint
+            RunCheckpoint::Unit unit;
+            if (checkpoint && checkpoint->load(file_index, slates.size(), unit)) {
+                for (size_t s = 0; s < slates.size(); ++s) {
+                    results[s].match_count += unit.match_counts[s];
+                    if (!unit.rows[s].empty()) appendOutput(s, file_index, unit.rows[s]);
+                }
+                coverage.covered.push_back({std::filesystem::path(file_path).filename().string(), unit.rows_checked, false});
+                covered[file_index] = 1;
+                metrics.files_resumed++;
+                progress.files_done.add(1);
+                continue;
+            }
+            TRACE_SCOPE("file", std::filesystem::path(file_path).filename().string());
+            
+            // Under a memory budget, files whose rows would not fit next to
+            // what the run already holds are compiled without their DataFrame
+            FileMetrics file_metrics;
+            uint64_t resident = metrics.memory.daily_slates_bytes + players.footprint() + values.footprint() +
+                                matrix.pattern_players.capacity() * sizeof(int32_t);
+            uint64_t file_size = std::filesystem::file_size(file_path);
+            
+            // A file whose indexed zone map rules out every slate is not even
+            // read. The hit matrix needs each file's patterns, so it reads all.
+            int64_t file_mtime = options.zone_index || result_cache ? ZoneIndex::modificationTime(file_path) : 0;
+            std::string file_name = std::filesystem::path(file_path).filename().string();
+            if (options.zone_index && !record_hits) {
+                const ZoneMap* zone = zone_index.find(file_name, file_size, file_mtime, filter.signature());
+                if (zone && !zone->mayMatch(probe)) {
+                    coverage.covered.push_back({file_name, zone->pattern_count, true});
+                    covered[file_index] = 1;
+                    metrics.files_skipped++;
+                    progress.files_done.add(1);
+                    continue;
+                }
+            }
+            
+            // A file whose every (daily player, file) pair is cached is not read either
+            ResultCache::Entry cached;
+            if (result_cache) {
+                cached = result_cache->load(file_name, file_size, file_mtime, filter.signature());
+                bool hit = !cached.players.empty();
+                std::vector<std::vector<std::pair<uint32_t, uint32_t>>> cached_matches(slates.size()); // (row, daily row)
+                for (size_t s = 0; s < slates.size() && hit; ++s) {
+                    for (uint64_t player_hash : cached.players) {
+                        auto player = slate_players[s].find(player_hash);
+                        if (player == slate_players[s].end()) continue;
+                        const std::vector<ResultCache::Match>* matches = cached.find(slates[s].fingerprints[player->second]);
+                        if (!matches) {
+                            hit = false;
+                            break;
+                        }
+                        for (const ResultCache::Match& match : *matches) {
+                            cached_matches[s].emplace_back(match.row, slates[s].rows_by_player[player->second][match.ordinal]);
+                        }
+                    }
+                }
+                if (hit) {
+                    for (size_t s = 0; s < slates.size(); ++s) {
+                        // Pattern order, then daily row order, as matchFile returns them
+                        std::sort(cached_matches[s].begin(), cached_matches[s].end());
+                        buffer.clear();
+                        for (const auto& [row, daily] : cached_matches[s]) {
+                            buffer += slates[s].rendered[daily];
+                            buffer += ',';
+                            buffer += cached.rows.at(row);
+                            buffer += '\n';
+                        }
+                        results[s].match_count += cached_matches[s].size();
+                        if (!buffer.empty()) appendOutput(s, file_index, buffer);
+                        if (!buffer.empty() && metrics.first_match_seconds < 0) {
+                            metrics.first_match_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_started).count();
+                        }
+                    }
+                    coverage.covered.push_back({file_name, cached.rows_checked, false});
+                    covered[file_index] = 1;
+                    metrics.files_cached++;
+                    progress.files_done.add(1);
+                    continue;
+                }
+            }
+            uint64_t inflated_size = file_size * (CSVLineReader::isCompressed(file_path) ? compressed_expansion : 1);
+            bool streaming = options.memory_budget > 0 &&
+                             resident + inflated_size * in_memory_expansion > options.memory_budget;
+            CompiledFile file;
+            try {
+                file = compileFile(file_path, &file_metrics, streaming, prefetched.valid() ? &prefetched : nullptr);
+            } catch (const std::bad_alloc&) {
+                if (streaming) throw;
+                file = compileFile(file_path, &file_metrics, true);
+            }
+            progress.bytes_read.add(file.bytes);
+            if (file_metrics.streamed) metrics.memory.streamed_files++;
+            if (options.memory_budget > 0 && resident + file.footprint() > options.memory_budget) {
+                metrics.memory.over_budget = true;
+            }
+            metrics.memory.peak_file_bytes = std::max<uint64_t>(metrics.memory.peak_file_bytes, file_metrics.footprint_bytes);
+            
+            size_t pattern_count = file.patterns.size();
+            uint64_t evaluated_before = progress.patterns_evaluated.load();
+            uint64_t past_deadline_before = rows_past_deadline.load();
+            auto match_started = std::chrono::steady_clock::now();
+            std::vector<uint8_t> live_blocks;
+            if (options.zone_index) {
+                zone_index.put(file_name, file_size, file_mtime, filter.signature(), file.zone);
+                live_blocks = liveBlocks(file, probe, file_metrics.blocks_skipped);
+            }
+            std::vector<std::vector<MatchRef>> file_matches(slates.size());
+            if (options.summary) {
+                file_metrics.matches = aggregateFile(file, static_cast<uint32_t>(file_index), slates,
+                                                     options.zone_index ? &live_blocks : nullptr, aggregates);
+            } else if (options.top_k > 0) {
+                file_metrics.matches = rankFile(file, static_cast<uint32_t>(file_index), slates,
+                                                options.zone_index ? &live_blocks : nullptr, options.top_k, top);
+            } else {
+                file_matches = matchFile(file, slates, options.zone_index ? &live_blocks : nullptr);
+            }
+            auto write_started = std::chrono::steady_clock::now();
+            file_metrics.match_us = microsecondsBetween(match_started, write_started);
+            file_metrics.patterns_evaluated = progress.patterns_evaluated.load() - evaluated_before;
+            // The budget ran out mid-file: its matches so far are kept, but
+            // they can't stand for the file in the checkpoint or the cache
+            uint64_t rows_unchecked = rows_past_deadline.load() - past_deadline_before;
+            bool file_partial = rows_unchecked > 0;
+            
+            uint32_t pattern_base = static_cast<uint32_t>(matrix.pattern_players.size());
+            if (record_hits) {
+                matrix.files.push_back({file.name, pattern_base, static_cast<uint32_t>(pattern_count)});
+                for (const CompiledPattern& pattern : file.patterns) {
+                    matrix.pattern_players.push_back(pattern.player);
+                }
+                for (size_t s = 0; s < slates.size(); ++s) {
+                    for (const MatchRef& match : file_matches[s]) matrix.hits[s].add(pattern_base + match.pattern);
+                }
+            }
+            // Append each day's matches to its output
+            TRACE_SCOPE("write", file.name);
+            PerfScope perf(profiling ? &hardware_profile : nullptr, HardwareProfile::STAGE_WRITE);
+            AllocationScope allocations(ALLOC_WRITE);
+            for (size_t s = 0; s < slates.size(); ++s) {
+                if (options.normalized) {
+                    results[s].match_count += file_matches[s].size();
+                    file_metrics.matches += file_matches[s].size();
+                    if (file_matches[s].empty()) continue;
+                    if (!normalized[s]) {
+                        results[s].output_path = NormalizedOutput::directoryFor(slates[s].daily_file);
+                        normalized[s] = std::make_unique<NormalizedOutput>(results[s].output_path, slates[s].rendered.size());
+                    }
+                    normalized[s]->add(static_cast<uint32_t>(file_index), file, file_matches[s]);
+                }
+                if (save_match_sets) {
+                    for (const MatchRef& match : file_matches[s]) {
+                        const CompiledPattern& pattern = file.patterns[match.pattern];
+                        match_sets[s].add(players.name(pattern.player), file.name, pattern.row);
+                    }
+                }
+                if (options.normalized) continue;
+                buffer.clear();
+                for (const MatchRef& match : file_matches[s]) {
+                    const CompiledPattern& pattern = file.patterns[match.pattern];
+                    if (delta) {
+                        const std::string& player = players.name(pattern.player);
+                        if (previous_matches.contains(player, file.name, pattern.row)) continue;
+                        CSVReader::appendCSVRow(buffer, {"+", player, file.name, std::to_string(pattern.row)});
+                        buffer += ',';
+                    }
+                    buffer += slates[s].rendered[match.daily];
+                    buffer += ',';
+                    buffer += file.rowText(pattern);
+                    buffer += '\n';
+                }
+                results[s].match_count += file_matches[s].size();
+                file_metrics.matches += file_matches[s].size();
+                if (checkpoint) {
+                    unit.match_counts.push_back(file_matches[s].size());
+                    unit.rows.push_back(buffer);
+                }
+                if (!buffer.empty()) appendOutput(s, file_index, buffer);
+            }
+            // A cancelled scan stops mid-file, so its rows can't stand for the file
+            if (checkpoint && !cancel_token.isCancelled() && !file_partial) {
+                unit.rows_checked = pattern_count;
+                checkpoint->save(file_index, unit);
+            }
+            if (result_cache && !cancel_token.isCancelled() && !file_partial) {
+                cacheResults(*result_cache, cached, file, slates, slate_players, daily_ordinals, file_matches);
+            }
+            if (file_metrics.matches > 0 && metrics.first_match_seconds < 0) {
+                metrics.first_match_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_started).count();
+            }
+            coverage.covered.push_back({file.name, pattern_count - rows_unchecked, false, file_partial});
+            covered[file_index] = 1;
+            
+            file_metrics.name = file.name;
+            file_metrics.bytes = file.bytes;
+            file_metrics.rows = pattern_count;
+            file_metrics.rows_dropped = file.rows_dropped;
+            file_metrics.write_us = microsecondsBetween(write_started, std::chrono::steady_clock::now());
+            uint64_t result_bytes = buffer.capacity();
+            for (const auto& refs : file_matches) result_bytes += refs.capacity() * sizeof(MatchRef);
+            metrics.memory.peak_result_bytes = std::max(metrics.memory.peak_result_bytes, result_bytes);
+            metrics.add(file_metrics);
+            progress.files_done.add(1);
+            if (file_partial) {
+                out_of_time = true;
+                break;
+            }
+        }
+        drain_read_ahead();
+        
+        // Outputs are only published once the whole folder has been matched
+        bool cancelled = cancel_token.isCancelled();
+        for (size_t s = 0; s < results.size(); ++s) {
+            if (normalized[s]) {
+                if (cancelled) {
+                    normalized[s]->discard();
+                    results[s].output_path.clear();
+                } else {
+                    normalized[s]->publish(slates[s]);
+                }
+            }
+            if (save_match_sets && !cancelled) {
+                match_sets[s].finish();
+                match_sets[s].save(MatchSet::pathFor(slates[s].daily_file));
+            }
+            // Dropped matches follow the added ones; the delta is written even when empty
+            if (delta && !cancelled) {
+                buffer.clear();
+                for (const MatchSet::Key& key : previous_matches.entries()) {
+                    const std::string& player = previous_matches.player(key);
+                    const std::string& file = previous_matches.file(key);
+                    if (match_sets[s].contains(player, file, key.row)) continue;
+                    CSVReader::appendCSVRow(buffer, {"-", player, file, std::to_string(key.row)});
+                    buffer += '\n';
+                }
+                appendOutput(s, hist_files.size(), buffer);
+            }
+            if (!outputs[s].is_open()) continue;
+            outputs[s].close();
+            std::string tmp_path = results[s].output_path + ".tmp";
+            if (cancelled) {
+                std::filesystem::remove(tmp_path);
+                results[s].output_path.clear();
+            } else {
+                if (prioritize) restoreFolderOrder(tmp_path, pieces[s]);
+                std::filesystem::rename(tmp_path, results[s].output_path);
+            }
+        }
+        for (RunResult& result : results) {
+            result.cancelled = cancelled;
+            result.partial = out_of_time && !cancelled;
+        }
+        if (checkpoint && !cancelled && !out_of_time) checkpoint->remove();
+        if (options.time_budget_seconds > 0 && !cancelled) {
+            for (size_t i = 0; i < hist_files.size(); ++i) {
+                if (!covered[i]) coverage.not_covered.push_back(std::filesystem::path(hist_files[i]).filename().string());
+            }
+            coverage.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_started).count();
+            for (size_t s = 0; s < slates.size(); ++s) {
+                results[s].coverage_path = coveragePathFor(slates[s].daily_file);
+                writeFileAtomically(results[s].coverage_path, coverage.toJson());
+            }
+        }
+        if (options.summary && !cancelled) {
+            TRACE_SCOPE("write summary", std::to_string(slates.size()) + " slates");
+            AllocationScope allocations(ALLOC_WRITE);
+            std::vector<std::string> file_names;
+            for (const std::string& path : hist_files) file_names.push_back(std::filesystem::path(path).filename().string());
+            for (size_t s = 0; s < slates.size(); ++s) {
+                for (const PlayerAggregate& aggregate : aggregates[s]) results[s].match_count += aggregate.matches;
+                results[s].output_path = summaryPathFor(slates[s].daily_file);
+                writeFileAtomically(results[s].output_path, renderSummary(slates[s], aggregates[s], file_names));
+            }
+        }
+        if (options.top_k > 0 && !cancelled) {
+            TRACE_SCOPE("write top", std::to_string(slates.size()) + " slates");
+            AllocationScope allocations(ALLOC_WRITE);
+            for (size_t s = 0; s < slates.size(); ++s) {
+                std::string output = renderTopK(slates[s], top[s], results[s].match_count);
+                if (output.empty()) continue;
+                results[s].output_path = topPathFor(slates[s].daily_file, options.top_k);
+                writeFileAtomically(results[s].output_path, output);
+            }
+        }
+        
+        if (record_hits && !cancelled) {
+            for (size_t p = 0; p < players.size(); ++p) {
+                matrix.players.push_back(players.name(static_cast<int32_t>(p)));
+            }
+            matrix.save(options.hit_matrix_path);
+        }
+        if (!options.trace_path.empty()) traceWrite(options.trace_path);
+        // The index is only a cache, so a cache directory we can't write to just goes without
+        if (options.zone_index && zone_index.isChanged()) {
+            try {
+                zone_index.save(ZoneIndex::pathFor(historical_folder, options.cache_dir));
+            } catch (const std::exception&) {
+            }
+        }
+        
+        metrics.cancelled = cancelled;
+        metrics.memory.dictionaries_bytes = players.footprint() + values.footprint();
+        metrics.memory.peak_rss_bytes = peakResidentBytes();
+        metrics.memory.finishAllocations();
+        metrics.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_started).count();
+        writeFileAtomically(options.metrics_path.empty() ? metricsPathFor(daily_files.front()) : options.metrics_path,
+                            metrics.toJson());
+        return results;
+    }
+
+private:
+    // Bytes a CSV takes once read into a DataFrame and compiled, per byte of
+    // file (~19 short cells per ~100-byte row, each a 32-byte std::string)
+    static constexpr uint64_t in_memory_expansion = 8;
+    // Assumed inflation of a .csv.gz / .csv.zz file; gzip -6 shrinks the
+    // corpus CSVs 10-20x
+    static constexpr uint64_t compressed_expansion = 10;
+    // Estimated in-memory bytes of the DataFrames read ahead at once
+    static constexpr uint64_t read_ahead_byte_limit = 512ull * 1024 * 1024;
+    // Compressed files read and inflated ahead of the one being matched
+    static size_t readAheadWindow(size_t threads) { return std::max<size_t>(1, std::min<size_t>(4, threads / 2)); }
+    
+    EngineProgress progress;
+    CancellationToken cancel_token;
+    // End of the time budget of the current processBatch; scanChunk stops
+    // there and counts the rows it left unchecked
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    PaddedCounter rows_past_deadline;
+    size_t thread_count = THREAD_NUM;
+    bool profiling = false;
+    HardwareProfile hardware_profile;
+    StringDictionary players;
+    StringDictionary values;
+    SelectivityStats selectivity;   // Orders the predicates compileRow emits
+    PatternFilter filter;
+    std::vector<uint64_t> value_hashes; // Value id -> hashText of its name, filled lazily
+    
+    // Records a freshly matched file's results for every daily player it has
+    // patterns of, including players without matches
+    void cacheResults(const ResultCache& cache, ResultCache::Entry& entry, const CompiledFile& file,
+                      const std::vector<DailySlate>& slates,
+                      const std::vector<std::unordered_map<uint64_t, int32_t>>& slate_players,
+                      const std::vector<std::vector<uint32_t>>& daily_ordinals,
+                      const std::vector<std::vector<MatchRef>>& file_matches) {
+        entry.rows_checked = file.patterns.size();
+        entry.players = file.zone.players;
+        for (size_t s = 0; s < slates.size(); ++s) {
+            std::unordered_map<int32_t, std::vector<ResultCache::Match>> by_player;
+            for (uint64_t player_hash : entry.players) {
+                auto player = slate_players[s].find(player_hash);
+                if (player != slate_players[s].end()) by_player[player->second];
+            }
+            for (const MatchRef& match : file_matches[s]) {
+                const CompiledPattern& pattern = file.patterns[match.pattern];
+                by_player[pattern.player].push_back({pattern.row, daily_ordinals[s][match.daily]});
+                entry.rows.emplace(pattern.row, file.rowText(pattern));
+            }
+            for (auto& [player, matches] : by_player) entry.put(slates[s].fingerprints[player], std::move(matches));
+        }
+        cache.save(file.name, entry);
+    }
+    
+    // A file's rows in an output written in visit order
+    struct OutputPiece {
+        size_t file_index;      // hist_files.size() for rows not from a file (a delta's dropped matches)
+        uint64_t offset;
+        uint64_t length;
+    };
+    
+    // Files whose players come first in the daily slates are visited first,
+    // so the earliest matches are found early. Indexed files of no daily
+    // player go before them: they are ruled out unread, so they add coverage
+    // for free. Files without an index entry, whose players aren't known
+    // before reading, follow in folder order.
+    std::vector<size_t> priorityOrder(const std::vector<std::string>& hist_files, const std::vector<DailySlate>& slates,
+                                      const ZoneIndex& zone_index) {
+        std::unordered_map<uint64_t, uint32_t> first_row;   // Player hash -> first daily row
+        for (const DailySlate& slate : slates) {
+            for (size_t player = 0; player < slate.rows_by_player.size(); ++player) {
+                if (slate.rows_by_player[player].empty()) continue;
+                uint32_t row = slate.rows_by_player[player].front();
+                auto [it, inserted] = first_row.emplace(hashText(players.name(static_cast<int32_t>(player))), row);
+                if (!inserted) it->second = std::min(it->second, row);
+            }
+        }
+        std::vector<std::pair<uint64_t, size_t>> keyed;
+        for (size_t i = 0; i < hist_files.size(); ++i) {
+            const std::string& path = hist_files[i];
+            uint64_t key = uint64_t(UINT32_MAX) + 1;
+            const ZoneMap* zone = zone_index.find(std::filesystem::path(path).filename().string(), std::filesystem::file_size(path),
+                                                  ZoneIndex::modificationTime(path), filter.signature());
+            if (zone) {
+                key = 0;
+                for (uint64_t player : zone->players) {
+                    auto it = first_row.find(player);
+                    if (it != first_row.end()) key = key == 0 ? it->second + 1 : std::min<uint64_t>(key, it->second + 1);
+                }
+            }
+            keyed.emplace_back(key, i);
+        }
+        std::stable_sort(keyed.begin(), keyed.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<size_t> order;
+        for (const auto& [key, index] : keyed) order.push_back(index);
+        return order;
+    }
+    
+    // Rewrites an output whose pieces were written in visit order so that
+    // they follow the folder order, byte for byte as a plain run writes it
+    static void restoreFolderOrder(const std::string& path, std::vector<OutputPiece> pieces) {
+        auto byFile = [](const OutputPiece& a, const OutputPiece& b) { return a.file_index < b.file_index; };
+        if (std::is_sorted(pieces.begin(), pieces.end(), byFile)) return;
+        std::stable_sort(pieces.begin(), pieces.end(), byFile);
+        std::ifstream in(path, std::ios::binary);
+        std::ofstream out(path + ".ordered", std::ios::binary);
+        std::string piece;
+        for (const OutputPiece& p : pieces) {
+            piece.resize(p.length);
+            in.seekg(static_cast<std::streamoff>(p.offset));
+            in.read(piece.data(), static_cast<std::streamsize>(p.length));
+            out << piece;
+        }
+        out.close();
+        if (!in || !out) {
+            throw std::runtime_error("Cannot write file: " + path);
+        }
+        in.close();
+        std::filesystem::rename(path + ".ordered", path);
+    }
+    
+    uint64_t valueHash(int32_t id) {
+        while (value_hashes.size() <= static_cast<size_t>(id)) {
+            value_hashes.push_back(hashText(values.name(static_cast<int32_t>(value_hashes.size()))));
+        }
+        return value_hashes[id];
+    }
+};
+
+// Historical folder compiled once and kept in memory for the long-running
+// modes. Matching holds a shared lock; reloading a changed file holds it
+// exclusively, so only that file is re-read.
+class ResidentCorpus {
+public:
+    // The filter is baked in: load and reloadFile compile only the rows it keeps
+    explicit ResidentCorpus(const std::string& historical_folder, const PatternFilter& filter = PatternFilter())
+        : folder(historical_folder) {
+        engine.setPatternFilter(filter);
+    }
+    
+    void load() {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        std::lock_guard<std::mutex> stats_lock(stats_mutex);
+        if (!std::filesystem::is_directory(folder)) {
+            throw std::runtime_error("Historical folder not found: " + folder);
+        }
+        files.clear();
+        std::vector<std::string> paths = DataProcessor::listHistoricalFiles(folder);
+        engine.getProgress().files_total.store(paths.size());
+        for (const std::string& path : paths) {
+            files.push_back(engine.compileFile(path));
+            engine.getProgress().bytes_read.add(files.back().bytes);
+            engine.getProgress().files_done.add(1);
+        }
+        generation++;
+        rebuildIndex();
+    }
+    
+    // Recompiles one historical file after it changed, or drops it if it is gone
+    void reloadFile(const std::string& path) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        std::lock_guard<std::mutex> stats_lock(stats_mutex);
+        auto it = std::lower_bound(files.begin(), files.end(), path,
+            [](const CompiledFile& file, const std::string& p) { return file.path < p; });
+        bool present = it != files.end() && it->path == path;
+        if (std::filesystem::is_regular_file(path)) {
+            CompiledFile file = engine.compileFile(path);
+            if (present) {
+                *it = std::move(file);
+            } else {
+                files.insert(it, std::move(file));
+            }
+        } else if (present) {
+            files.erase(it);
+        }
+        generation++;
+        rebuildIndex();
+    }
+    
+    DailySlate compileSlate(const std::string& daily_file, const DataFrame& raw_daily_df) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return engine.compileDailySlate(daily_file, raw_daily_df, true);
+    }
+    
+    // Consecutive slates of one client mostly differ in a few fast columns, so
+    // a session keeps each player's results and the client's next slate
+    // re-evaluates only the patterns that read a cell that changed. Give each
+    // client (connection, watcher, Python Corpus) its own. A session busy in
+    // another call is not waited for: that call evaluates from scratch.
+    class Session {
+    private:
+        friend class ResidentCorpus;
+        struct PlayerState {
+            std::vector<std::array<DailyCell, 22>> cells;   // The player's daily rows last evaluated
+            std::vector<std::vector<uint64_t>> satisfied;   // Per row, a bit per player_index entry
+        };
+        std::mutex in_use;
+        uint64_t generation = 0;                // Corpus generation the states belong to
+        std::vector<PlayerState> players;
+    };
+    
+    // Matches a slate against the resident patterns of its players and renders
+    // the result in the _Matches.csv layout and order
+    std::string matchSlate(const DailySlate& slate, size_t& match_count, Session* session = nullptr) {
+        adaptPredicateOrder(slate);
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<SlateMatch> matches = findMatchesLocked(slate, 1, session);
+        match_count = matches.size();
+        return renderMatchesLocked(slate, matches);
+    }
+    
+    // (file index, row in that file, daily row)
+    using SlateMatch = std::array<uint32_t, 3>;
+    
+    // Matches sorted in output order; players are split across thread_count
+    // threads. found_in receives the corpus generation the indices refer to.
+    std::vector<SlateMatch> findMatches(const DailySlate& slate, size_t thread_count, uint64_t& found_in,
+                                        Session* session = nullptr) {
+        adaptPredicateOrder(slate);
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        found_in = generation;
+        return findMatchesLocked(slate, thread_count, session);
+    }
+    
+    // Matches found before a load or reload can't be rendered: their file
+    // indices may point elsewhere now
+    std::string renderMatches(const DailySlate& slate, const std::vector<SlateMatch>& matches, uint64_t found_in) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (found_in != generation) {
+            throw std::runtime_error("The corpus was reloaded after these matches were found");
+        }
+        return renderMatchesLocked(slate, matches);
+    }
+    
+    std::vector<std::string> fileNames() {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<std::string> names;
+        for (const CompiledFile& file : files) names.push_back(file.name);
+        return names;
+    }
+    
+    const std::string& getFolder() const { return folder; }
+    
+    size_t fileCount() {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return files.size();
+    }
+    
+    size_t patternCount() {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        size_t count = 0;
+        for (const CompiledFile& file : files) count += file.patterns.size();
+        return count;
+    }
+    
+    // Pattern checks spent and spared by incremental re-evaluation
+    uint64_t patternsRechecked() const { return patterns_rechecked.load(std::memory_order_relaxed); }
+    uint64_t patternsReused() const { return patterns_reused.load(std::memory_order_relaxed); }
+
+private:
+    std::string folder;
+    DataProcessor engine;   // Owns the dictionaries the patterns are compiled against
+    std::vector<CompiledFile> files;    // Sorted by path
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> player_index; // Player -> (file, pattern), in file order
+    std::shared_mutex mutex;
+    uint64_t generation = 0;    // Bumped by load and reloadFile
+    std::mutex stats_mutex;     // Guards the engine's selectivity; taken after mutex, never before
+    uint64_t ordered_rows = 0;  // Daily rows observed when the predicates were last ordered
+    
+    // A player's patterns grouped by the set of columns their predicates read;
+    // a group none of whose columns changed keeps its results (Session)
+    struct ColumnGroup {
+        uint32_t columns = 0;           // Bit per daily column
+        std::vector<uint32_t> entries;  // Positions in player_index[player]
+    };
+    std::vector<std::vector<ColumnGroup>> column_groups;    // Player -> groups
+    std::atomic<uint64_t> patterns_rechecked{0};
+    std::atomic<uint64_t> patterns_reused{0};
+    
+    static bool sameCell(const DailyCell& a, const DailyCell& b) {
+        return a.present == b.present && a.value == b.value && a.degree_valid == b.degree_valid && a.degree == b.degree;
+    }
+    
+    // Folds the slate into the selectivity statistics. Once they have doubled
+    // since the last ordering, every file's predicates are re-sorted; matches
+    // only refer to patterns, so reordering keeps the generation.
+    void adaptPredicateOrder(const DailySlate& slate) {
+        SelectivityStats snapshot;
+        {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex);
+            SelectivityStats& stats = engine.getSelectivity();
+            stats.observe(slate);
+            if (stats.rowsObserved() < 2 * ordered_rows || stats.rowsObserved() == 0) return;
+            ordered_rows = stats.rowsObserved();
+            snapshot = stats;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        for (CompiledFile& file : files) snapshot.orderFile(file);
+    }
+    
+    // Only ever holds mutex shared; the session is the caller's alone while
+    // its in_use lock is held, and its threads touch disjoint players
+    std::vector<SlateMatch> findMatchesLocked(const DailySlate& slate, size_t thread_count, Session* session) {
+        Session scratch;
+        std::unique_lock<std::mutex> session_lock;
+        if (session) session_lock = std::unique_lock<std::mutex>(session->in_use, std::try_to_lock);
+        if (!session || !session_lock.owns_lock()) session = &scratch;
+        if (session->generation != generation) {
+            session->players.clear();   // Pattern indices changed, so the kept results are void
+            session->generation = generation;
+        }
+        std::vector<Session::PlayerState>& player_state = session->players;
+        size_t player_count = std::min(slate.rows_by_player.size(), player_index.size());
+        if (player_state.size() < player_count) player_state.resize(player_count);
+        auto matchPlayers = [this, &slate, &player_state, player_count, thread_count](size_t first) {
+            std::vector<SlateMatch> matches;
+            uint64_t rechecked = 0;
+            uint64_t reused = 0;
+            for (size_t player = first; player < player_count; player += thread_count) {
+                const std::vector<uint32_t>& daily_rows = slate.rows_by_player[player];
+                if (daily_rows.empty()) continue;
+                const auto& entries = player_index[player];
+                Session::PlayerState& state = player_state[player];
+                size_t known = std::min(state.cells.size(), daily_rows.size());
+                state.cells.resize(daily_rows.size());
+                state.satisfied.resize(daily_rows.size());
+                for (size_t j = 0; j < daily_rows.size(); ++j) {
+                    const std::array<DailyCell, 22>& cells = slate.cells[daily_rows[j]];
+                    std::vector<uint64_t>& satisfied = state.satisfied[j];
+                    uint32_t changed = 0;
+                    if (j < known) {
+                        for (size_t c = 0; c < cells.size(); ++c) {
+                            if (!sameCell(state.cells[j][c], cells[c])) changed |= 1u << c;
+                        }
+                    } else {
+                        satisfied.assign((entries.size() + 63) / 64, 0);
+                    }
+                    for (const ColumnGroup& group : column_groups[player]) {
+                        if (j < known && !(group.columns & changed)) {
+                            reused += group.entries.size();
+                            continue;
+                        }
+                        rechecked += group.entries.size();
+                        for (uint32_t e : group.entries) {
+                            const CompiledFile& file = files[entries[e].first];
+                            const CompiledPattern& pattern = file.patterns[entries[e].second];
+                            uint64_t bit = uint64_t(1) << (e % 64);
+                            if (DataProcessor::patternMatches(file.predicates.data() + pattern.pred_begin, pattern.pred_count, cells)) {
+                                satisfied[e / 64] |= bit;
+                            } else {
+                                satisfied[e / 64] &= ~bit;
+                            }
+                        }
+                    }
+                    state.cells[j] = cells;
+                    for (size_t w = 0; w < satisfied.size(); ++w) {
+                        for (uint64_t word = satisfied[w]; word; word &= word - 1) {
+                            const auto& [f, p] = entries[w * 64 + __builtin_ctzll(word)];
+                            matches.push_back({f, files[f].patterns[p].row, daily_rows[j]});
+                        }
+                    }
+                }
+            }
+            patterns_rechecked.fetch_add(rechecked, std::memory_order_relaxed);
+            patterns_reused.fetch_add(reused, std::memory_order_relaxed);
+            return matches;
+        };
+        
+        thread_count = std::max<size_t>(1, std::min(thread_count, player_count));
+        std::vector<SlateMatch> matches;
+        if (thread_count == 1) {
+            matches = matchPlayers(0);
+        } else {
+            std::vector<std::future<std::vector<SlateMatch>>> futures;
+            for (size_t t = 0; t < thread_count; ++t) {
+                futures.push_back(std::async(std::launch::async, matchPlayers, t));
+            }
+            for (auto& future : futures) {
+                std::vector<SlateMatch> part = future.get();
+                matches.insert(matches.end(), part.begin(), part.end());
+            }
+        }
+        std::sort(matches.begin(), matches.end());
+        return matches;
+    }
+    
+    std::string renderMatchesLocked(const DailySlate& slate, const std::vector<SlateMatch>& matches) {
+        std::string output;
+        for (const auto& [f, row, i] : matches) {
+            output += slate.rendered[i];
+            output += ',';
+            output += files[f].rowText(patternForRow(files[f], row));
+            output += '\n';
+        }
+        return output;
+    }
+    
+    // Patterns are in row order; without a filter the row is the index
+    static const CompiledPattern& patternForRow(const CompiledFile& file, uint32_t row) {
+        if (row < file.patterns.size() && file.patterns[row].row == row) return file.patterns[row];
+        return *std::lower_bound(file.patterns.begin(), file.patterns.end(), row,
+            [](const CompiledPattern& pattern, uint32_t r) { return pattern.row < r; });
+    }
+    
+    void rebuildIndex() {
+        player_index.clear();
+        for (size_t f = 0; f < files.size(); ++f) {
+            for (size_t p = 0; p < files[f].patterns.size(); ++p) {
+                size_t player = static_cast<size_t>(files[f].patterns[p].player);
+                if (player >= player_index.size()) player_index.resize(player + 1);
+                player_index[player].emplace_back(static_cast<uint32_t>(f), static_cast<uint32_t>(p));
+            }
+        }
+        
+        column_groups.assign(player_index.size(), {});
+        for (size_t player = 0; player < player_index.size(); ++player) {
+            std::unordered_map<uint32_t, size_t> group_of;
+            for (size_t e = 0; e < player_index[player].size(); ++e) {
+                const auto& [f, p] = player_index[player][e];
+                const CompiledPattern& pattern = files[f].patterns[p];
+                uint32_t columns = 0;
+                for (uint32_t i = 0; i < pattern.pred_count; ++i) {
+                    columns |= 1u << files[f].predicates[pattern.pred_begin + i].col;
+                }
+                auto [it, inserted] = group_of.emplace(columns, column_groups[player].size());
+                if (inserted) column_groups[player].push_back({columns, {}});
+                column_groups[player][it->second].entries.push_back(static_cast<uint32_t>(e));
+            }
+        }
+    }
+};
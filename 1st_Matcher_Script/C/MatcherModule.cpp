@@ -0,0 +1,363 @@
+// CPython extension exposing the matching engine as the matcher_engine module.
+// Build with setup.py (python setup.py build_ext --inplace).
+//
+//     import matcher_engine
+//     corpus = matcher_engine.Corpus("Single_Players_..._Grouped_output_001")
+//     matches = corpus.match("daily.csv")        # or corpus.match(csv_bytes)
+//     table = numpy.frombuffer(matches, dtype=numpy.uint32).reshape(-1, 3)
+//     open("daily_Matches.csv", "wb").write(matches.csv())
+//
+// Loading and matching run with the GIL released, on the engine's threads.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "MatcherEngine.hpp"
+
+// Runs fn with the GIL released and turns C++ exceptions into Python ones.
+// Returns false with the Python error set if fn threw.
+template <typename Fn>
+static bool runWithoutGIL(Fn&& fn) {
+    std::string error;
+    bool out_of_memory = false;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        fn();
+    } catch (const std::bad_alloc&) {
+        out_of_memory = true;
+    } catch (const std::exception& e) {
+        error = e.what();
+        if (error.empty()) error = "matcher_engine error";
+    }
+    Py_END_ALLOW_THREADS
+    if (out_of_memory) {
+        PyErr_NoMemory();
+        return false;
+    }
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ---- Matches -------------------------------------------------------------
+
+// Result of Corpus.match. Exposes the matches through the buffer protocol as
+// an (n, 3) uint32 array of (file index, row in file, daily row), in the
+// _Matches.csv order; csv() renders that file's contents.
+struct MatchesObject {
+    PyObject_HEAD
+    std::shared_ptr<ResidentCorpus> corpus;     // Keeps the patterns alive for csv()
+    DailySlate* slate;
+    std::vector<ResidentCorpus::SlateMatch>* matches;
+    uint64_t generation;                // Corpus generation the file indices refer to
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+static PyTypeObject MatchesType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// The corpus is shared with the Matches it produced and with calls running
+// without the GIL, so it outlives the Python object when they do
+struct CorpusObject {
+    PyObject_HEAD
+    std::shared_ptr<ResidentCorpus> corpus;
+    std::shared_ptr<ResidentCorpus::Session> session;  // Successive match() calls re-evaluate incrementally
+    size_t thread_count;
+};
+
+static PyTypeObject CorpusType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+static void Matches_dealloc(MatchesObject* self) {
+    delete self->slate;
+    delete self->matches;
+    self->corpus.~shared_ptr();
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static Py_ssize_t Matches_length(MatchesObject* self) {
+    return static_cast<Py_ssize_t>(self->matches->size());
+}
+
+static int Matches_getbuffer(MatchesObject* self, Py_buffer* view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "Matches are read-only");
+        return -1;
+    }
+    static uint32_t empty[3] = {0, 0, 0};
+    view->buf = self->matches->empty() ? empty : self->matches->data()->data();
+    view->obj = reinterpret_cast<PyObject*>(self);
+    Py_INCREF(self);
+    view->len = self->shape[0] * 3 * sizeof(uint32_t);
+    view->readonly = 1;
+    view->itemsize = sizeof(uint32_t);
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("I") : nullptr;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) ? self->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+static PyObject* Matches_csv(MatchesObject* self, PyObject*) {
+    ResidentCorpus* corpus = self->corpus.get();
+    std::string text;
+    if (!runWithoutGIL([&]() { text = corpus->renderMatches(*self->slate, *self->matches, self->generation); })) return nullptr;
+    return PyBytes_FromStringAndSize(text.data(), static_cast<Py_ssize_t>(text.size()));
+}
+
+static PyObject* Matches_tolist(MatchesObject* self, PyObject*) {
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(self->matches->size()));
+    if (!list) return nullptr;
+    for (size_t i = 0; i < self->matches->size(); ++i) {
+        const auto& [f, p, d] = (*self->matches)[i];
+        PyObject* item = Py_BuildValue("(III)", f, p, d);
+        if (!item) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+    }
+    return list;
+}
+
+static PyMethodDef Matches_methods[] = {
+    {"csv", reinterpret_cast<PyCFunction>(Matches_csv), METH_NOARGS,
+     "csv() -> bytes\n\nThe matches rendered exactly as the _Matches.csv output."},
+    {"tolist", reinterpret_cast<PyCFunction>(Matches_tolist), METH_NOARGS,
+     "tolist() -> list of (file index, row in file, daily row) tuples."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PySequenceMethods Matches_as_sequence = {};
+static PyBufferProcs Matches_as_buffer = {};
+
+// ---- Corpus --------------------------------------------------------------
+
+static PyObject* Corpus_new(PyTypeObject* type, PyObject*, PyObject*) {
+    CorpusObject* self = reinterpret_cast<CorpusObject*>(type->tp_alloc(type, 0));
+    if (!self) return nullptr;
+    new (&self->corpus) std::shared_ptr<ResidentCorpus>();
+    new (&self->session) std::shared_ptr<ResidentCorpus::Session>(std::make_shared<ResidentCorpus::Session>());
+    self->thread_count = THREAD_NUM;
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static void Corpus_dealloc(CorpusObject* self) {
+    self->corpus.~shared_ptr();
+    self->session.~shared_ptr();
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static int Corpus_init(CorpusObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"historical_folder", "threads", "min_total", "min_win_percent",
+                                     "max_rows_per_player", nullptr};
+    PyObject* folder_arg = nullptr;
+    Py_ssize_t threads = THREAD_NUM;
+    PatternFilter filter;
+    unsigned int max_rows = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|n$ddI", const_cast<char**>(keywords),
+                                     PyUnicode_FSConverter, &folder_arg, &threads,
+                                     &filter.min_total, &filter.min_win_percent, &max_rows)) {
+        return -1;
+    }
+    filter.max_rows_per_player = max_rows;
+    std::string folder = PyBytes_AS_STRING(folder_arg);
+    Py_DECREF(folder_arg);
+
+    // Matches and running calls refer to the loaded corpus; a new folder
+    // needs a new Corpus
+    if (self->corpus) {
+        PyErr_SetString(PyExc_RuntimeError, "Corpus is already loaded");
+        return -1;
+    }
+    auto corpus = std::make_shared<ResidentCorpus>(folder, filter);
+    if (!runWithoutGIL([&]() { corpus->load(); })) return -1;
+    if (self->corpus) {
+        PyErr_SetString(PyExc_RuntimeError, "Corpus is already loaded");
+        return -1;
+    }
+    self->thread_count = static_cast<size_t>(std::max<Py_ssize_t>(1, threads));
+    self->corpus = std::move(corpus);
+    return 0;
+}
+
+static bool checkLoaded(CorpusObject* self) {
+    if (self->corpus) return true;
+    PyErr_SetString(PyExc_RuntimeError, "Corpus is not loaded");
+    return false;
+}
+
+// daily is a path (str or os.PathLike) to a .csv/.xlsx file, or any
+// buffer-protocol object (bytes, bytearray, memoryview, numpy) holding CSV text
+static PyObject* Corpus_match(CorpusObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"daily", nullptr};
+    PyObject* daily = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", const_cast<char**>(keywords), &daily)) return nullptr;
+    if (!checkLoaded(self)) return nullptr;
+
+    std::string daily_file;
+    Py_buffer text = {};
+    bool from_buffer = !PyUnicode_Check(daily) && PyObject_CheckBuffer(daily);
+    if (from_buffer) {
+        if (PyObject_GetBuffer(daily, &text, PyBUF_SIMPLE) < 0) return nullptr;
+        daily_file = "<buffer>";
+    } else {
+        PyObject* path = nullptr;
+        if (!PyUnicode_FSConverter(daily, &path)) return nullptr;
+        daily_file = PyBytes_AS_STRING(path);
+        Py_DECREF(path);
+    }
+
+    std::shared_ptr<ResidentCorpus> corpus = self->corpus;
+    std::shared_ptr<ResidentCorpus::Session> session = self->session;
+    size_t thread_count = self->thread_count;
+    auto slate = std::make_unique<DailySlate>();
+    auto matches = std::make_unique<std::vector<ResidentCorpus::SlateMatch>>();
+    uint64_t generation = 0;
+    bool ok = runWithoutGIL([&]() {
+        DataFrame raw_daily_df = from_buffer
+            ? CSVReader::readCSVText(std::string_view(static_cast<const char*>(text.buf), text.len))
+            : CSVReader::readCSV(daily_file);
+        *slate = corpus->compileSlate(daily_file, raw_daily_df);
+        *matches = corpus->findMatches(*slate, thread_count, generation, session.get());
+    });
+    if (from_buffer) PyBuffer_Release(&text);
+    if (!ok) return nullptr;
+
+    MatchesObject* result = PyObject_New(MatchesObject, &MatchesType);
+    if (!result) return nullptr;
+    new (&result->corpus) std::shared_ptr<ResidentCorpus>(std::move(corpus));
+    result->slate = slate.release();
+    result->matches = matches.release();
+    result->generation = generation;
+    result->shape[0] = static_cast<Py_ssize_t>(result->matches->size());
+    result->shape[1] = 3;
+    result->strides[0] = 3 * sizeof(uint32_t);
+    result->strides[1] = sizeof(uint32_t);
+    return reinterpret_cast<PyObject*>(result);
+}
+
+static PyObject* Corpus_reload(CorpusObject* self, PyObject* args) {
+    PyObject* path_arg = nullptr;
+    if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path_arg)) return nullptr;
+    std::string path = PyBytes_AS_STRING(path_arg);
+    Py_DECREF(path_arg);
+    if (!checkLoaded(self)) return nullptr;
+    std::shared_ptr<ResidentCorpus> corpus = self->corpus;
+    if (!runWithoutGIL([&]() { corpus->reloadFile(path); })) return nullptr;
+    Py_RETURN_NONE;
+}
+
+static PyObject* Corpus_get_files(CorpusObject* self, void*) {
+    if (!checkLoaded(self)) return nullptr;
+    std::vector<std::string> names = self->corpus->fileNames();
+    PyObject* tuple = PyTuple_New(static_cast<Py_ssize_t>(names.size()));
+    if (!tuple) return nullptr;
+    for (size_t i = 0; i < names.size(); ++i) {
+        PyObject* name = PyUnicode_DecodeFSDefault(names[i].c_str());
+        if (!name) {
+            Py_DECREF(tuple);
+            return nullptr;
+        }
+        PyTuple_SET_ITEM(tuple, static_cast<Py_ssize_t>(i), name);
+    }
+    return tuple;
+}
+
+static PyObject* Corpus_get_pattern_count(CorpusObject* self, void*) {
+    if (!checkLoaded(self)) return nullptr;
+    return PyLong_FromSize_t(self->corpus->patternCount());
+}
+
+static PyMethodDef Corpus_methods[] = {
+    {"match", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(Corpus_match)), METH_VARARGS | METH_KEYWORDS,
+     "match(daily) -> Matches\n\ndaily is a .csv/.xlsx path or a buffer holding CSV text."},
+    {"reload", reinterpret_cast<PyCFunction>(Corpus_reload), METH_VARARGS,
+     "reload(path)\n\nRecompiles one historical file after it changed, or drops it if it is gone.\n"
+     "Matches found earlier keep their arrays but can no longer render csv()."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyGetSetDef Corpus_getset[] = {
+    {"files", reinterpret_cast<getter>(Corpus_get_files), nullptr,
+     "Historical file names; Matches file indices point into this tuple.", nullptr},
+    {"pattern_count", reinterpret_cast<getter>(Corpus_get_pattern_count), nullptr, "Number of compiled rows.", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+// ---- Module --------------------------------------------------------------
+
+// match(daily, historical_folder, threads=8): one-shot Corpus(...).match(daily)
+static PyObject* module_match(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"daily", "historical_folder", "threads", nullptr};
+    PyObject* daily = nullptr;
+    PyObject* folder = nullptr;
+    Py_ssize_t threads = THREAD_NUM;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|n", const_cast<char**>(keywords), &daily, &folder, &threads)) {
+        return nullptr;
+    }
+    PyObject* corpus = PyObject_CallFunction(reinterpret_cast<PyObject*>(&CorpusType), "On", folder, threads);
+    if (!corpus) return nullptr;
+    PyObject* result = PyObject_CallMethod(corpus, "match", "O", daily);
+    Py_DECREF(corpus);
+    return result;
+}
+
+static PyMethodDef module_methods[] = {
+    {"match", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(module_match)), METH_VARARGS | METH_KEYWORDS,
+     "match(daily, historical_folder, threads=8) -> Matches\n\nLoads the folder and matches one daily file or buffer."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyModuleDef matcher_module = {
+    PyModuleDef_HEAD_INIT, "matcher_engine", "Native matching engine of Matcher.cpp.", -1, module_methods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+PyMODINIT_FUNC PyInit_matcher_engine(void) {
+    Matches_as_sequence.sq_length = reinterpret_cast<lenfunc>(Matches_length);
+    Matches_as_buffer.bf_getbuffer = reinterpret_cast<getbufferproc>(Matches_getbuffer);
+
+    MatchesType.tp_name = "matcher_engine.Matches";
+    MatchesType.tp_basicsize = sizeof(MatchesObject);
+    MatchesType.tp_dealloc = reinterpret_cast<destructor>(Matches_dealloc);
+    MatchesType.tp_as_sequence = &Matches_as_sequence;
+    MatchesType.tp_as_buffer = &Matches_as_buffer;
+    MatchesType.tp_flags = Py_TPFLAGS_DEFAULT;
+    MatchesType.tp_doc = "Matches of one daily slate as an (n, 3) uint32 buffer of (file, row, daily row).";
+    MatchesType.tp_methods = Matches_methods;
+
+    CorpusType.tp_name = "matcher_engine.Corpus";
+    CorpusType.tp_basicsize = sizeof(CorpusObject);
+    CorpusType.tp_dealloc = reinterpret_cast<destructor>(Corpus_dealloc);
+    CorpusType.tp_flags = Py_TPFLAGS_DEFAULT;
+    CorpusType.tp_doc = "Corpus(historical_folder, threads=8, *, min_total=0, min_win_percent=0, max_rows_per_player=0)\n\n"
+                        "Historical folder compiled once and kept in memory. Rows below min_total or\n"
+                        "min_win_percent, and a file's rows past the player's max_rows_per_player\n"
+                        "strongest, are left out of the compiled corpus.";
+    CorpusType.tp_methods = Corpus_methods;
+    CorpusType.tp_getset = Corpus_getset;
+    CorpusType.tp_init = reinterpret_cast<initproc>(Corpus_init);
+    CorpusType.tp_new = Corpus_new;
+
+    if (PyType_Ready(&MatchesType) < 0 || PyType_Ready(&CorpusType) < 0) return nullptr;
+
+    PyObject* module = PyModule_Create(&matcher_module);
+    if (!module) return nullptr;
+    Py_INCREF(&CorpusType);
+    if (PyModule_AddObject(module, "Corpus", reinterpret_cast<PyObject*>(&CorpusType)) < 0) {
+        Py_DECREF(&CorpusType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    Py_INCREF(&MatchesType);
+    if (PyModule_AddObject(module, "Matches", reinterpret_cast<PyObject*>(&MatchesType)) < 0) {
+        Py_DECREF(&MatchesType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,534 @@
+#include "MatcherEngine.hpp"
+#include <random>
+
+// Focused tests of the engine paths whose failures would go unnoticed in an
+// output: runs that must agree however they are split, resumed, cached or
+// re-evaluated, and inputs that must fail loudly. Each test writes a small
+// corpus to its own temporary directory. Exits non-zero when a check fails.
+
+int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+void check(bool ok, const char* what, const char* file, int line) {
+    if (ok) return;
+    failures++;
+    std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+}
+
+// True when fn throws a runtime_error whose message contains text
+template <typename Fn>
+bool throwsWith(Fn&& fn, const std::string& text) {
+    try {
+        fn();
+    } catch (const std::runtime_error& error) {
+        return std::string(error.what()).find(text) != std::string::npos;
+    }
+    return false;
+}
+
+std::string readText(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+void writeText(const std::string& path, const std::string& text) {
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+}
+
+// A fresh directory under the system temporary directory, removed afterwards
+class TempDir {
+public:
+    explicit TempDir(const std::string& name) {
+        auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        path = (std::filesystem::temp_directory_path() / ("matcher-tests-" + name + "-" + std::to_string(stamp))).string();
+        std::filesystem::create_directories(path);
+    }
+
+    ~TempDir() {
+        std::error_code ignored;
+        std::filesystem::remove_all(path, ignored);
+    }
+
+    std::string operator/(const std::string& name) const { return path + "/" + name; }
+
+    std::string path;
+};
+
+const std::vector<std::string> signs = {
+    "Aries", "Taurus", "Gemini", "Cancer", "Leo", "Virgo",
+    "Libra", "Scorpio", "Sagittarius", "Capricorn", "Aquarius", "Pisces"
+};
+
+const std::vector<std::string> degree_buckets = {
+    "000-004", "005-008", "009-012", "013-016", "017-020", "021-024", "025-029"
+};
+
+// A player's placements. Historical rows mostly repeat them, so a slate
+// built from the same chart matches a few percent of its player's rows.
+struct Chart {
+    int sign[11];
+    int degree[11];
+};
+
+Chart chartFor(size_t player) {
+    std::mt19937_64 random(player * 7919 + 1);
+    Chart chart;
+    for (int planet = 0; planet < 11; ++planet) {
+        chart.sign[planet] = static_cast<int>(random() % signs.size());
+        chart.degree[planet] = static_cast<int>(random() % 30);
+    }
+    return chart;
+}
+
+const std::string& bucketOf(int degree) {
+    return degree_buckets[degree < 5 ? 0 : std::min<size_t>((degree - 5) / 4 + 1, degree_buckets.size() - 1)];
+}
+
+std::string playerName(size_t player) { return "player-" + std::to_string(player); }
+
+std::string historicalPath(const std::string& folder, size_t player) {
+    return folder + "/split_A_" + playerName(player) + "_Size_4_Degree_YES.csv";
+}
+
+// Rows of one player's file, shaped like the split_*_Size_4 files: four
+// (sign, degree bucket) planet pairs in column order, then Total and WinPercent
+std::string historicalRows(size_t player, size_t rows, uint64_t seed) {
+    std::mt19937_64 random(seed);
+    Chart chart = chartFor(player);
+    std::string text;
+    for (size_t r = 0; r < rows; ++r) {
+        std::vector<int> planets;
+        while (planets.size() < 4) {
+            int planet = static_cast<int>(random() % 11);
+            if (std::find(planets.begin(), planets.end(), planet) == planets.end()) planets.push_back(planet);
+        }
+        std::sort(planets.begin(), planets.end());
+        text += playerName(player);
+        for (int planet : planets) {
+            int sign = random() % 4 ? chart.sign[planet] : static_cast<int>(random() % signs.size());
+            int degree = random() % 4 ? chart.degree[planet] : static_cast<int>(random() % 30);
+            text += ',' + daily_cols[planet * 2] + ',' + signs[sign];
+            text += ',' + daily_cols[planet * 2 + 1] + ',' + bucketOf(degree);
+        }
+        text += ',' + std::to_string(1 + random() % 5) + ',' + (random() % 4 ? "0.0" : "0.5") + '\n';
+    }
+    return text;
+}
+
+// One file per player, of different lengths
+void writeCorpus(const std::string& folder, size_t players) {
+    std::filesystem::create_directories(folder);
+    for (size_t p = 0; p < players; ++p) writeText(historicalPath(folder, p), historicalRows(p, 150 + 40 * p, p + 1));
+}
+
+// 63 columns: name, 40 info columns, then sign and degree of every planet
+std::string dailyRow(const std::string& name, const Chart& chart) {
+    std::string row = name;
+    for (int c = 1; c <= 40; ++c) row += ",info" + std::to_string(c);
+    for (int planet = 0; planet < 11; ++planet) {
+        char degree[8];
+        snprintf(degree, sizeof(degree), "%03d", chart.degree[planet]);
+        row += ',' + signs[chart.sign[planet]] + ',' + degree;
+    }
+    return row + '\n';
+}
+
+// A day's slate: each player's chart with the fast planets moved on by day,
+// a second row for every other player and one player with no file
+std::string dailySlate(size_t players, int day) {
+    std::string text;
+    for (size_t p = 0; p < players; ++p) {
+        Chart chart = chartFor(p);
+        chart.degree[0] = (chart.degree[0] + 13 * day) % 30;
+        chart.degree[1] = (chart.degree[1] + day) % 30;
+        text += dailyRow(playerName(p), chart);
+        if (p % 2 == 0) {
+            chart.degree[2] = (chart.degree[2] + 7) % 30;
+            text += dailyRow(playerName(p), chart);
+        }
+    }
+    return text + dailyRow("daily-only", chartFor(players + 100));
+}
+
+// Options writing every cache under the test directory, never the user's
+DataProcessor::RunOptions optionsIn(const TempDir& dir) {
+    DataProcessor::RunOptions options;
+    options.cache_dir = dir / "cache";
+    return options;
+}
+
+// The text of each daily file's output, empty when nothing matched
+std::vector<std::string> run(const std::vector<std::string>& daily_files, const std::string& historical_folder,
+                             const DataProcessor::RunOptions& options) {
+    DataProcessor engine;
+    engine.setThreadCount(2);
+    std::vector<std::string> outputs;
+    for (const DataProcessor::RunResult& result : engine.processBatch(daily_files, historical_folder, options)) {
+        outputs.push_back(result.output_path.empty() ? "" : readText(result.output_path));
+    }
+    return outputs;
+}
+
+// A counter from the run metrics written next to the daily file's output
+uint64_t metric(const std::string& daily_file, const std::string& name) {
+    std::string json = readText(DataProcessor::metricsPathFor(daily_file));
+    std::string key = "\"" + name + "\": ";
+    size_t at = json.find(key);
+    return at == std::string::npos ? UINT64_MAX : std::stoull(json.substr(at + key.size()));
+}
+
+// One batch over several days writes what a run of each day alone writes
+void testBatchMatchesSingleRuns() {
+    TempDir dir("batch");
+    writeCorpus(dir / "corpus", 6);
+    std::vector<std::string> daily_files;
+    for (int day = 0; day < 3; ++day) {
+        daily_files.push_back(dir / ("day" + std::to_string(day) + ".csv"));
+        writeText(daily_files.back(), dailySlate(8, day));
+    }
+    std::vector<std::string> batch = run(daily_files, dir / "corpus", optionsIn(dir));
+    CHECK(batch.size() == daily_files.size());
+    for (size_t d = 0; d < daily_files.size() && d < batch.size(); ++d) {
+        CHECK(!batch[d].empty());
+        CHECK(run({daily_files[d]}, dir / "corpus", optionsIn(dir)).front() == batch[d]);
+    }
+}
+
+// The per-player cap keeps the highest Total, then WinPercent, rows. Rows
+// whose statistics are not numbers ("12abc", "nan") rank below every row
+// whose statistics are.
+void testRowCapRanksUnparsableLast() {
+    TempDir dir("row-cap");
+    std::filesystem::create_directories(dir / "corpus");
+    Chart chart = chartFor(0);
+    std::string pattern = playerName(0);
+    for (int planet = 3; planet < 7; ++planet) {
+        pattern += ',' + daily_cols[planet * 2] + ',' + signs[chart.sign[planet]];
+        pattern += ',' + daily_cols[planet * 2 + 1] + ',' + bucketOf(chart.degree[planet]);
+    }
+    const std::vector<std::string> statistics = {"12abc,0.5", "nan,0.5", "4,nan", "3,0.25", "2,0.9", "inf5,0.1"};
+    std::string text;
+    for (const std::string& statistic : statistics) text += pattern + ',' + statistic + '\n';
+    writeText(historicalPath(dir / "corpus", 0), text);
+    std::string daily = dir / "day.csv";
+    writeText(daily, dailySlate(1, 0));
+
+    DataProcessor::RunOptions options = optionsIn(dir);
+    options.filter.max_rows_per_player = 2;
+    std::string output = run({daily}, dir / "corpus", options).front();
+    CHECK(output.find("\"4\",\"nan\"\n") != std::string::npos);
+    CHECK(output.find("\"3\",\"0.25\"\n") != std::string::npos);
+    for (const char* dropped : {"12abc", "\"nan\",\"0.5\"", "\"2\",\"0.9\"", "inf5"}) {
+        CHECK(output.find(dropped) == std::string::npos);
+    }
+}
+
+// A saved hit matrix loads back as it was. Corrupt bitmap containers (too
+// many, oversized, out of order), hits past the last pattern and a
+// truncated file are refused.
+void testHitMatrixRejectsCorruptFiles() {
+    TempDir dir("hit-matrix");
+    HitMatrix matrix;
+    matrix.days = {"day"};
+    matrix.files = {{"file.csv", 0, 10}};
+    matrix.players = {playerName(0)};
+    matrix.pattern_players.assign(10, 0);
+    matrix.hits.resize(1);
+    matrix.hits[0].add(3);
+    matrix.hits[0].add(7);
+    std::string path = dir / "hits.bin";
+    matrix.save(path);
+    CHECK(!std::filesystem::exists(path + ".tmp"));
+    HitMatrix loaded = HitMatrix::load(path);
+    CHECK(loaded.patternCount() == 10);
+    CHECK(loaded.hits.size() == 1 && loaded.hits[0].cardinality() == 2 && loaded.hits[0].contains(7));
+
+    // The bitmap ends the file: container count, key, type, array size, two ids
+    std::string bytes = readText(path);
+    size_t bitmap = bytes.size() - 15;
+    auto corrupted = [&](size_t offset, const void* value, size_t size) {
+        std::string changed = bytes;
+        changed.replace(offset, size, static_cast<const char*>(value), size);
+        writeText(dir / "corrupt.bin", changed);
+        return dir / "corrupt.bin";
+    };
+    uint32_t too_many = 70000;
+    CHECK(throwsWith([&]() { HitMatrix::load(corrupted(bitmap, &too_many, 4)); }, "Corrupt hit matrix"));
+    uint32_t too_large = 5000;
+    CHECK(throwsWith([&]() { HitMatrix::load(corrupted(bitmap + 7, &too_large, 4)); }, "Corrupt hit matrix"));
+    uint16_t unordered[2] = {7, 3};
+    CHECK(throwsWith([&]() { HitMatrix::load(corrupted(bitmap + 11, unordered, 4)); }, "Corrupt hit matrix"));
+    uint16_t beyond[2] = {3, 12};
+    CHECK(throwsWith([&]() { HitMatrix::load(corrupted(bitmap + 11, beyond, 4)); }, "Corrupt hit matrix"));
+    writeText(dir / "corrupt.bin", bytes.substr(0, bytes.size() - 2));
+    CHECK(throwsWith([&]() { HitMatrix::load(dir / "corrupt.bin"); }, ""));
+}
+
+// A session re-evaluates only the patterns reading changed cells; it must
+// match what a fresh evaluation matches as slates change day to day, lose
+// players and rows, and after a historical file is reloaded
+void testSessionMatchesFullEvaluation() {
+    TempDir dir("session");
+    writeCorpus(dir / "corpus", 5);
+    ResidentCorpus corpus(dir / "corpus");
+    corpus.load();
+    ResidentCorpus::Session session;
+    size_t total = 0;
+    auto compare = [&](const std::string& text) {
+        writeText(dir / "slate.csv", text);
+        DailySlate slate = corpus.compileSlate("slate.csv", CSVReader::readCSV(dir / "slate.csv"));
+        size_t incremental_count = 0;
+        size_t full_count = 0;
+        std::string incremental = corpus.matchSlate(slate, incremental_count, &session);
+        CHECK(incremental == corpus.matchSlate(slate, full_count));
+        CHECK(incremental_count == full_count);
+        total += full_count;
+    };
+    for (int day = 0; day < 5; ++day) compare(dailySlate(5, day));
+    CHECK(total > 0);
+    CHECK(corpus.patternsReused() > 0);
+    compare(dailySlate(3, 5));
+    compare(dailySlate(5, 5));
+    writeText(historicalPath(dir / "corpus", 1), historicalRows(1, 260, 99));
+    corpus.reloadFile(historicalPath(dir / "corpus", 1));
+    compare(dailySlate(5, 5));
+    std::filesystem::remove(historicalPath(dir / "corpus", 3));
+    corpus.reloadFile(historicalPath(dir / "corpus", 3));
+    compare(dailySlate(5, 6));
+}
+
+// Runs the daily file with a checkpoint and cancels it once the second
+// historical file has matched, leaving the journal of the first behind
+bool interruptRun(const std::string& daily_file, const std::string& historical_folder,
+                  const DataProcessor::RunOptions& options) {
+    DataProcessor engine;
+    engine.setThreadCount(1);
+    size_t files_matched = 0;
+    DataProcessor::RunOptions interrupted = options;
+    interrupted.on_matches = [&](const std::string&, const std::string&) {
+        if (++files_matched == 2) engine.getCancelToken().cancel();
+    };
+    return engine.processBatch({daily_file}, historical_folder, interrupted).front().cancelled;
+}
+
+// A resumed run writes what an uninterrupted one writes, and the journal of
+// a run over other inputs (a changed file, another filter) is not replayed
+void testCheckpointResume() {
+    TempDir dir("checkpoint");
+    writeCorpus(dir / "corpus", 6);
+    std::string daily = dir / "day.csv";
+    writeText(daily, dailySlate(6, 1));
+    std::string expected = run({daily}, dir / "corpus", optionsIn(dir)).front();
+    DataProcessor::RunOptions options = optionsIn(dir);
+    options.checkpoint_dir = dir / "checkpoint";
+
+    CHECK(interruptRun(daily, dir / "corpus", options));
+    CHECK(std::filesystem::exists(dir / "checkpoint/manifest"));
+    CHECK(run({daily}, dir / "corpus", options).front() == expected);
+    CHECK(metric(daily, "files_resumed") > 0);
+    CHECK(!std::filesystem::exists(dir / "checkpoint"));
+
+    CHECK(interruptRun(daily, dir / "corpus", options));
+    writeText(historicalPath(dir / "corpus", 0), historicalRows(0, 230, 77));
+    std::string changed = run({daily}, dir / "corpus", optionsIn(dir)).front();
+    CHECK(changed != expected);
+    CHECK(run({daily}, dir / "corpus", options).front() == changed);
+    CHECK(metric(daily, "files_resumed") == 0);
+
+    CHECK(interruptRun(daily, dir / "corpus", options));
+    DataProcessor::RunOptions filtered = optionsIn(dir);
+    filtered.filter.min_total = 3;
+    std::string filtered_expected = run({daily}, dir / "corpus", filtered).front();
+    filtered.checkpoint_dir = options.checkpoint_dir;
+    CHECK(run({daily}, dir / "corpus", filtered).front() == filtered_expected);
+    CHECK(metric(daily, "files_resumed") == 0);
+}
+
+// Only the journal's own files are ever deleted: a directory holding other
+// files and no manifest is refused, and files added to a journal stay
+void testCheckpointKeepsForeignFiles() {
+    TempDir dir("checkpoint-foreign");
+    writeCorpus(dir / "corpus", 4);
+    std::string daily = dir / "day.csv";
+    writeText(daily, dailySlate(4, 2));
+    std::string expected = run({daily}, dir / "corpus", optionsIn(dir)).front();
+    DataProcessor::RunOptions options = optionsIn(dir);
+
+    std::filesystem::create_directories(dir / "notes");
+    writeText(dir / "notes/keep.txt", "mine");
+    options.checkpoint_dir = dir / "notes";
+    CHECK(throwsWith([&]() { run({daily}, dir / "corpus", options); }, "Not a checkpoint directory"));
+    CHECK(readText(dir / "notes/keep.txt") == "mine");
+
+    options.checkpoint_dir = dir / "checkpoint";
+    CHECK(interruptRun(daily, dir / "corpus", options));
+    writeText(dir / "checkpoint/keep.txt", "mine");
+    CHECK(run({daily}, dir / "corpus", options).front() == expected);
+    CHECK(readText(dir / "checkpoint/keep.txt") == "mine");
+    CHECK(!std::filesystem::exists(dir / "checkpoint/manifest"));
+}
+
+// Replaces text in a file without changing its size and moves its
+// modification time on, even on file systems with coarse timestamps
+void rewriteSameSize(const std::string& path, const std::string& from, const std::string& to) {
+    auto mtime = std::filesystem::last_write_time(path);
+    std::string text = readText(path);
+    for (size_t at = text.find(from); at != std::string::npos; at = text.find(from, at + to.size())) {
+        text.replace(at, from.size(), to);
+    }
+    writeText(path, text);
+    std::filesystem::last_write_time(path, mtime + std::chrono::seconds(2));
+}
+
+// Zone maps and cached results stand only for the file version, filter and
+// slate they were made with. A run using both writes what a run using
+// neither writes as files change (same size, only the mtime telling), the
+// filter and the slate change, and the cache files are corrupted.
+void testCacheInvalidation() {
+    TempDir dir("cache");
+    std::string corpus = dir / "corpus";
+    writeCorpus(corpus, 5);
+    std::string daily = dir / "day.csv";
+    writeText(daily, dailySlate(5, 3));
+    DataProcessor::RunOptions uncached = optionsIn(dir);
+    uncached.zone_index = false;
+    auto agree = [&](const DataProcessor::RunOptions& options) {
+        DataProcessor::RunOptions cached = options;
+        cached.zone_index = true;
+        cached.result_cache = true;
+        std::string expected = run({daily}, corpus, options).front();
+        CHECK(run({daily}, corpus, cached).front() == expected);
+        return expected;
+    };
+
+    std::string original = agree(uncached);
+    CHECK(!original.empty());
+    agree(uncached);
+    CHECK(metric(daily, "files_cached") == 5);
+
+    rewriteSameSize(historicalPath(corpus, 2), playerName(2) + ",", playerName(9) + ",");
+    CHECK(agree(uncached) != original);
+    CHECK(metric(daily, "files_cached") == 4);
+    rewriteSameSize(historicalPath(corpus, 2), playerName(9) + ",", playerName(2) + ",");
+    CHECK(agree(uncached) == original);
+    CHECK(metric(daily, "files_cached") == 4);
+
+    std::ofstream(historicalPath(corpus, 3), std::ios::binary | std::ios::app) << historicalRows(3, 60, 5);
+    CHECK(agree(uncached) != original);
+
+    DataProcessor::RunOptions filtered = uncached;
+    filtered.filter.min_total = 3;
+    agree(filtered);
+    agree(uncached);
+
+    writeText(daily, dailySlate(5, 4));
+    agree(uncached);
+
+    writeText(ZoneIndex::pathFor(corpus, uncached.cache_dir), "not a zone index");
+    for (const auto& entry : std::filesystem::directory_iterator(ResultCache::directoryFor(corpus, uncached.cache_dir))) {
+        writeText(entry.path().string(), "not a result");
+    }
+    agree(uncached);
+    CHECK(metric(daily, "files_cached") == 0);
+}
+
+#ifdef MATCHER_WITH_ZLIB
+// Writes text gzipped in members of member_size bytes, as parallel compressors do
+void writeGzip(const std::string& path, const std::string& text, size_t member_size) {
+    std::filesystem::remove(path);
+    for (size_t at = 0; at < text.size(); at += member_size) {
+        gzFile file = gzopen(path.c_str(), "ab");
+        if (!file) throw std::runtime_error("Cannot write file: " + path);
+        std::string member = text.substr(at, member_size);
+        gzwrite(file, member.data(), static_cast<unsigned>(member.size()));
+        gzclose(file);
+    }
+}
+
+std::vector<std::string> readLines(const std::string& path) {
+    CSVLineReader reader(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (reader.next(line)) lines.push_back(line);
+    return lines;
+}
+
+// Gzipped historical files, in one member or several, match like the plain
+// files. A truncated or corrupt one fails the read, and the run, instead of
+// quietly ending the file early.
+void testCompressedInput() {
+    TempDir dir("gzip");
+    writeCorpus(dir / "plain", 4);
+    std::filesystem::create_directories(dir / "gz");
+    for (size_t p = 0; p < 4; ++p) {
+        std::string text = readText(historicalPath(dir / "plain", p));
+        writeGzip(historicalPath(dir / "gz", p) + ".gz", text, p % 2 ? text.size() : 4000);
+    }
+    std::string daily = dir / "day.csv";
+    writeText(daily, dailySlate(4, 1));
+    std::string expected = run({daily}, dir / "plain", optionsIn(dir)).front();
+    CHECK(!expected.empty());
+    CHECK(run({daily}, dir / "gz", optionsIn(dir)).front() == expected);
+
+    std::string gzipped = historicalPath(dir / "gz", 0) + ".gz";
+    std::vector<std::string> lines;
+    std::istringstream plain(readText(historicalPath(dir / "plain", 0)));
+    for (std::string line; std::getline(plain, line);) lines.push_back(line);
+    CHECK(readLines(gzipped) == lines);
+
+    std::string bytes = readText(historicalPath(dir / "gz", 1) + ".gz");
+    writeText(dir / "half.csv.gz", bytes.substr(0, bytes.size() / 2));
+    CHECK(throwsWith([&]() { readLines(dir / "half.csv.gz"); }, "Truncated compressed file"));
+    writeText(dir / "no-trailer.csv.gz", bytes.substr(0, bytes.size() - 4));
+    CHECK(throwsWith([&]() { readLines(dir / "no-trailer.csv.gz"); }, "Truncated compressed file"));
+    std::string corrupt = bytes;
+    for (size_t i = 40; i < 80 && i < corrupt.size(); ++i) corrupt[i] = static_cast<char>(corrupt[i] ^ 0x5A);
+    writeText(dir / "corrupt.csv.gz", corrupt);
+    CHECK(throwsWith([&]() { readLines(dir / "corrupt.csv.gz"); }, "Corrupt compressed file"));
+
+    writeText(historicalPath(dir / "gz", 2) + ".gz", bytes.substr(0, bytes.size() / 2));
+    CHECK(throwsWith([&]() { run({daily}, dir / "gz", optionsIn(dir)); }, "Truncated compressed file"));
+}
+#else
+// Builds without zlib don't list compressed files and refuse to read one
+void testCompressedInput() {
+    TempDir dir("gzip");
+    writeCorpus(dir / "corpus", 2);
+    writeText(dir / "corpus/split_A_extra.csv.gz", "not read");
+    CHECK(DataProcessor::listHistoricalFiles(dir / "corpus").size() == 2);
+    CHECK(throwsWith([&]() { CSVLineReader reader(dir / "corpus/split_A_extra.csv.gz"); }, "MATCHER_WITH_ZLIB"));
+}
+#endif
+
+int main() {
+    const std::vector<std::pair<std::string, void (*)()>> tests = {
+        {"batch matches single runs", testBatchMatchesSingleRuns},
+        {"row cap ranks unparsable statistics last", testRowCapRanksUnparsableLast},
+        {"hit matrix rejects corrupt files", testHitMatrixRejectsCorruptFiles},
+        {"session matches full evaluation", testSessionMatchesFullEvaluation},
+        {"checkpoint resume", testCheckpointResume},
+        {"checkpoint keeps foreign files", testCheckpointKeepsForeignFiles},
+        {"cache invalidation", testCacheInvalidation},
+        {"compressed input", testCompressedInput},
+    };
+    for (const auto& [name, test] : tests) {
+        int before = failures;
+        try {
+            test();
+        } catch (const std::exception& error) {
+            failures++;
+            std::cerr << name << ": " << error.what() << std::endl;
+        }
+        std::cout << (failures == before ? "ok    " : "FAIL  ") << name << std::endl;
+    }
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,44 @@
+import os
+import sys
+from setuptools import setup, Extension
+
+# Builds the matcher_engine extension from MatcherModule.cpp:
+#
+#   python setup.py build_ext --inplace
+#
+# The engine uses GCC builtins, so on Windows build with MinGW
+# (python setup.py build_ext --inplace --compiler=mingw32), like Matcher.cpp.
+
+extra_compile_args = ['-std=c++17', '-O2']
+extra_link_args = []
+if sys.platform != 'win32':
+    extra_compile_args.append('-pthread')
+    extra_link_args.append('-pthread')
+
+# Reading .csv.gz / .csv.zz historical files needs zlib:
+#
+#   MATCHER_WITH_ZLIB=1 python setup.py build_ext --inplace
+libraries = ['xlnt']
+define_macros = []
+if os.environ.get('MATCHER_WITH_ZLIB'):
+    libraries.append('z')
+    define_macros.append(('MATCHER_WITH_ZLIB', None))
+
+setup(
+    name='matcher_engine',
+    version='1.0',
+    description='Native matching engine of Matcher.cpp',
+    ext_modules=[
+        Extension(
+            'matcher_engine',
+            sources=['MatcherModule.cpp'],
+            include_dirs=['include'],
+            library_dirs=['lib'],
+            libraries=libraries,
+            define_macros=define_macros,
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
+            language='c++',
+        )
+    ],
+)
@@ -0,0 +1,159 @@
+import os
+import sys
+import csv
+import math
+import time
+import shutil
+import argparse
+import tempfile
+import subprocess
+import multiprocessing
+import importlib.util
+from collections import Counter
+import pandas as pd
+
+# Differential check of the C++ matcher against Zmatcher_non_coloring_Ver1.3.py.
+# Runs the reference multiprocess_rows headlessly and the C++ command line on the
+# same inputs, then compares the two match sets ignoring order.
+#
+#   python Differential_Check.py --cpp ../C/Matcher --daily daily.csv --hist folder
+#   python Differential_Check.py --cpp ../C/Matcher --bench ../C/MatcherBench --scale 0.05
+#
+# The C++ side must be the command-line build (non-Windows); the Win32 build is a
+# GUI and takes no arguments. WInPercent_Matcher_MultiProcess_Ver1.2.py has no
+# command-line C++ counterpart, so only the 1st matcher is checked.
+
+REFERENCE_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'Zmatcher_non_coloring_Ver1.3.py')
+
+# Loaded at import time so spawned pool workers resolve multiprocess_rows as well
+_spec = importlib.util.spec_from_file_location('zmatcher_reference', REFERENCE_SCRIPT)
+reference = importlib.util.module_from_spec(_spec)
+sys.modules['zmatcher_reference'] = reference
+_spec.loader.exec_module(reference)
+
+def silence_worker():
+    # multiprocess_rows prints a line per historical row
+    sys.stdout = open(os.devnull, 'w')
+
+def read_input(path):
+    return pd.read_csv(path, header=None) if path.endswith('csv') else pd.read_excel(path, header=None)
+
+def list_inputs(folder):
+    # The C++ matcher reads only .csv, .xlsx and .xls files
+    return sorted(f for f in os.listdir(folder) if f.lower().endswith(('.csv', '.xlsx', '.xls')))
+
+def run_python(daily_file, historical_folder, processes):
+    # Same steps as process_files, without the GUI and the Excel writer
+    raw_daily_df = read_input(daily_file)
+    daily_df = raw_daily_df[[0] + list(range(41, 63))]
+    daily_df.columns = ['Player'] + reference.daily_cols
+
+    all_matches = []
+    with multiprocessing.get_context("spawn").Pool(processes, initializer=silence_worker) as pool:
+        for file_name in list_inputs(historical_folder):
+            raw_hist_df = read_input(os.path.join(historical_folder, file_name))
+            all_rows = list(raw_hist_df.iterrows())
+            chunk_size = math.ceil(len(all_rows) / processes)
+            chunks = [all_rows[i:i + chunk_size] for i in range(0, len(all_rows), chunk_size)]
+            one_result = pool.map(reference.multiprocess_rows, [(chunk, daily_df, raw_daily_df) for chunk in chunks])
+            all_matches.extend(row for group in one_result for row in group if row)
+    return all_matches
+
+def run_cpp(executable, daily_file, historical_folder):
+    result = subprocess.run([executable, daily_file, historical_folder], capture_output=True, text=True)
+    if result.returncode != 0:
+        raise RuntimeError(f"C++ matcher failed: {result.stderr.strip()}")
+    output_path = os.path.splitext(daily_file)[0] + '_Matches.csv'
+    if not os.path.exists(output_path):
+        return []
+    with open(output_path, newline='') as f:
+        return list(csv.reader(f))
+
+def normalize_cell(value):
+    # pandas turns "014" into 14 and "1" into 1.0, and pads short rows with NaN
+    if value is None or (isinstance(value, float) and math.isnan(value)):
+        return None
+    text = str(value).strip()
+    if not text or text == 'nan':
+        return None
+    try:
+        number = float(text)
+        return repr(int(number)) if number.is_integer() else repr(number)
+    except ValueError:
+        return text
+
+def normalize_row(row):
+    # Empty cells are dropped: the two sides pad daily rows to different widths
+    return tuple(cell for cell in map(normalize_cell, row) if cell is not None)
+
+def prepare_inputs(args, work_dir):
+    if args.bench:
+        listing = subprocess.run([args.bench, '--generate-only', '--work', os.path.join(work_dir, 'bench'),
+                                  '--scales', str(args.scale), '--seed', str(args.seed)],
+                                 capture_output=True, text=True, check=True)
+        historical_folder, daily_file = listing.stdout.strip().split('\t')
+    else:
+        historical_folder, daily_file = args.hist, args.daily
+
+    # Inputs are copied so the C++ output lands in the work directory
+    daily_copy = os.path.join(work_dir, os.path.basename(daily_file))
+    shutil.copyfile(daily_file, daily_copy)
+    if args.files:
+        subset = os.path.join(work_dir, 'historical')
+        os.makedirs(subset, exist_ok=True)
+        for file_name in list_inputs(historical_folder)[:args.files]:
+            shutil.copyfile(os.path.join(historical_folder, file_name), os.path.join(subset, file_name))
+        historical_folder = subset
+    return daily_copy, historical_folder
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare the C++ matcher with the Python reference")
+    parser.add_argument('--cpp', required=True, help="C++ command-line matcher executable")
+    parser.add_argument('--daily', help="daily file (.csv or .xlsx)")
+    parser.add_argument('--hist', help="historical folder")
+    parser.add_argument('--bench', help="MatcherBench executable, to generate the inputs instead")
+    parser.add_argument('--scale', type=float, default=0.05, help="generated corpus scale (1 = letter-A sample)")
+    parser.add_argument('--seed', type=int, default=20250712)
+    parser.add_argument('--files', type=int, default=0, help="only the first N historical files")
+    parser.add_argument('--processes', type=int, default=os.cpu_count())
+    parser.add_argument('--show', type=int, default=5, help="differing rows to print per side")
+    args = parser.parse_args()
+    if not args.bench and not (args.daily and args.hist):
+        parser.error("either --bench or both --daily and --hist are required")
+
+    work_dir = tempfile.mkdtemp(prefix='matcher_diff_')
+    try:
+        daily_file, historical_folder = prepare_inputs(args, work_dir)
+        print(f"Daily: {daily_file}\nHistorical: {historical_folder} ({len(list_inputs(historical_folder))} files)")
+
+        started = time.perf_counter()
+        python_rows = run_python(daily_file, historical_folder, args.processes)
+        python_seconds = time.perf_counter() - started
+
+        started = time.perf_counter()
+        cpp_rows = run_cpp(args.cpp, daily_file, historical_folder)
+        cpp_seconds = time.perf_counter() - started
+
+        python_set = Counter(map(normalize_row, python_rows))
+        cpp_set = Counter(map(normalize_row, cpp_rows))
+        only_python = python_set - cpp_set
+        only_cpp = cpp_set - python_set
+
+        print(f"Python: {len(python_rows)} matches in {python_seconds:.2f}s ({args.processes} processes)")
+        print(f"C++:    {len(cpp_rows)} matches in {cpp_seconds:.2f}s")
+        print(f"Speedup: {python_seconds / cpp_seconds:.1f}x")
+        for label, rows in (("Only in Python", only_python), ("Only in C++", only_cpp)):
+            if rows:
+                print(f"{label}: {sum(rows.values())} rows")
+                for row in list(rows)[:args.show]:
+                    print("  " + ",".join(row))
+        if only_python or only_cpp:
+            print("MISMATCH")
+            return 1
+        print("MATCH")
+        return 0
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+if __name__ == "__main__":
+    sys.exit(main())